@@ -7,7 +7,7 @@ INPUT="input.txt"
 RESULTS_DIR="results"
 
 echo "Compiling..."
-g++ -std=c++17 -O3 -march=native -o "$BIN" "$SRC"
+g++ -std=c++17 -O3 -march=native -pthread -o "$BIN" "$SRC"
 
 mkdir -p "$RESULTS_DIR"
 
@@ -21,6 +21,7 @@ run_algo() {
 
 run_algo lookahead
 run_algo bidirectional
+run_algo greedy
 run_algo hybrid
 
 echo "All tests done."
@@ -5,6 +5,17 @@
 #include <algorithm>
 #include <chrono>
 #include <limits>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <queue>
 
 using namespace std;
 using namespace std::chrono;
@@ -37,34 +48,119 @@ void writeOutput(const string& filename, const string& result) {
     file.close();
 }
 
-bool isSubstring(const string& s1, const string& s2) {
-    return s2.find(s1) != string::npos;
-}
+// Trie of all strings with Aho-Corasick fail links. Children are sibling
+// lists, which is compact for the small alphabets of the inputs. nodes are
+// numbered in BFS order, so fail[u] < u.
+struct AhoCorasick {
+    struct Node {
+        int firstChild = -1, nextSibling = -1;
+        int fail = 0, depth = 0;
+        char c = 0;
+    };
 
-vector<string> removeSubstrings(const vector<string>& strings) {
-    vector<string> result;
-    int n = strings.size();
-    
-    for (int i = 0; i < n; i++) {
-        bool isSub = false;
-        for (int j = 0; j < n; j++) {
-            if (i != j && isSubstring(strings[i], strings[j])) {
-                isSub = true;
-                break;
+    vector<Node> nodes;
+    vector<int> terminal;  // node spelling strings[i]
+
+    explicit AhoCorasick(const vector<string>& strings) : terminal(strings.size()) {
+        vector<Node> trie(1);
+        for (size_t i = 0; i < strings.size(); i++) {
+            int u = 0;
+            for (char c : strings[i]) {
+                int v = childOf(trie, u, c);
+                if (v < 0) {
+                    v = trie.size();
+                    trie.push_back(Node());
+                    trie[v].c = c;
+                    trie[v].depth = trie[u].depth + 1;
+                    trie[v].nextSibling = trie[u].firstChild;
+                    trie[u].firstChild = v;
+                }
+                u = v;
             }
+            terminal[i] = u;
+        }
+
+        // Renumber in BFS order and set the fail links
+        vector<int> order(1, 0), id(trie.size());
+        for (size_t k = 0; k < order.size(); k++) {
+            for (int v = trie[order[k]].firstChild; v >= 0; v = trie[v].nextSibling) order.push_back(v);
+        }
+        for (size_t k = 0; k < order.size(); k++) id[order[k]] = k;
+        nodes.resize(trie.size());
+        for (size_t k = 0; k < order.size(); k++) {
+            const Node& old = trie[order[k]];
+            Node& node = nodes[k];
+            node.c = old.c;
+            node.depth = old.depth;
+            node.firstChild = old.firstChild < 0 ? -1 : id[old.firstChild];
+            node.nextSibling = old.nextSibling < 0 ? -1 : id[old.nextSibling];
         }
-        if (!isSub) {
-            result.push_back(strings[i]);
+        for (int& u : terminal) u = id[u];
+
+        for (int u = 0; u < (int)nodes.size(); u++) {
+            for (int v = nodes[u].firstChild; v >= 0; v = nodes[v].nextSibling) {
+                nodes[v].fail = u == 0 ? 0 : step(nodes[u].fail, nodes[v].c);
+            }
         }
     }
-    
+
+    int child(int u, char c) const { return childOf(nodes, u, c); }
+
+    // Automaton transition: longest trie node that is a suffix of state + c
+    int step(int state, char c) const {
+        while (true) {
+            int v = child(state, c);
+            if (v >= 0) return v;
+            if (state == 0) return 0;
+            state = nodes[state].fail;
+        }
+    }
+
+private:
+    static int childOf(const vector<Node>& nodes, int u, char c) {
+        for (int v = nodes[u].firstChild; v >= 0; v = nodes[v].nextSibling) {
+            if (nodes[v].c == c) return v;
+        }
+        return -1;
+    }
+};
+
+// Drops every string that occurs inside another one and keeps only the
+// first of equal strings, in O(sum L). All strings run through the
+// automaton and mark the states they reach; a string's last state is its
+// own node, so there its fail link is marked instead. Marks then spread
+// along the fail links, since every suffix of an occurrence occurs too.
+vector<string> removeSubstrings(const vector<string>& strings) {
+    AhoCorasick ac(strings);
+    int m = ac.nodes.size();
+
+    vector<char> inside(m, 0);
+    for (const auto& s : strings) {
+        int state = 0;
+        for (size_t p = 0; p < s.size(); p++) {
+            state = ac.step(state, s[p]);
+            inside[p + 1 < s.size() ? state : ac.nodes[state].fail] = 1;
+        }
+    }
+    for (int u = m - 1; u > 0; u--) {
+        if (inside[u]) inside[ac.nodes[u].fail] = 1;
+    }
+
+    vector<char> taken(m, 0);
+    vector<string> result;
+    for (size_t i = 0; i < strings.size(); i++) {
+        int u = ac.terminal[i];
+        if (inside[u] || taken[u]) continue;
+        taken[u] = 1;
+        result.push_back(strings[i]);
+    }
     return result;
 }
 
 int computeOverlap(const string& s1, const string& s2) {
     int maxLen = min(s1.length(), s2.length());
     for (int k = maxLen; k > 0; k--) {
-        if (s1.substr(s1.length() - k) == s2.substr(0, k)) {
+        if (s1.compare(s1.length() - k, k, s2, 0, k) == 0) {
             return k;
         }
     }
@@ -75,19 +171,172 @@ string mergeWithOverlap(const string& s1, const string& s2, int overlap) {
     return s1 + s2.substr(overlap);
 }
 
+// All-pairs overlaps, Gusfield-style on the Aho-Corasick trie. The fail
+// chain from the node of s_i visits every suffix of s_i that is a prefix of
+// some string. A DFS over the trie keeps, for each i, the depth of the
+// deepest such node on the current path, so at the node of s_j that depth
+// is overlap[i][j]. visit(j, best, saved) is called at the node of every
+// s_j; `saved` lists (i, depth before) for each string whose best depth
+// was set on the current path, i.e. every i with overlap[i][j] > 0.
+template <class Visit>
+void forEachOverlapColumn(const vector<string>& strings, const Visit& visit) {
+    int n = strings.size();
+    AhoCorasick ac(strings);
+    int m = ac.nodes.size();
+
+    // suffixOf[u]: strings that have node u as a suffix, as linked lists
+    vector<int> head(m, -1), next, owner;
+    for (int i = 0; i < n; i++) {
+        for (int u = ac.terminal[i]; u != 0; u = ac.nodes[u].fail) {
+            owner.push_back(i);
+            next.push_back(head[u]);
+            head[u] = owner.size() - 1;
+        }
+    }
+    vector<int> endsHere(m, -1), nextEnd(n, -1);
+    for (int j = n - 1; j >= 0; j--) {
+        nextEnd[j] = endsHere[ac.terminal[j]];
+        endsHere[ac.terminal[j]] = j;
+    }
+
+    vector<int> best(n, 0);
+    vector<pair<int, int>> saved;  // (string, depth before entering)
+    vector<pair<int, bool>> stack = {{0, false}};
+    while (!stack.empty()) {
+        auto [u, leaving] = stack.back();
+        stack.pop_back();
+        if (leaving) {
+            for (int e = head[u]; e >= 0; e = next[e]) {
+                best[saved.back().first] = saved.back().second;
+                saved.pop_back();
+            }
+            continue;
+        }
+
+        for (int e = head[u]; e >= 0; e = next[e]) {
+            saved.push_back({owner[e], best[owner[e]]});
+            best[owner[e]] = ac.nodes[u].depth;
+        }
+        for (int j = endsHere[u]; j >= 0; j = nextEnd[j]) visit(j, best, saved);
+        stack.push_back({u, true});
+        for (int v = ac.nodes[u].firstChild; v >= 0; v = ac.nodes[v].nextSibling) stack.push_back({v, false});
+    }
+}
+
+// Dense n x n matrix in O(sum L + n^2)
 vector<vector<int>> buildOverlapMatrix(const vector<string>& strings) {
     int n = strings.size();
     vector<vector<int>> overlap(n, vector<int>(n, 0));
-    for (int i = 0; i < n; i++) {
-        for (int j = 0; j < n; j++) {
-            if (i != j) {
-                overlap[i][j] = computeOverlap(strings[i], strings[j]);
+    if (n == 0) return overlap;
+
+    forEachOverlapColumn(strings, [&](int j, const vector<int>& best, const vector<pair<int, int>>&) {
+        overlap[j] = best;
+    });
+
+    // Rows were filled per end string j; transpose in cache-sized blocks
+    const int block = 64;
+    for (int bi = 0; bi < n; bi += block) {
+        for (int bj = bi; bj < n; bj += block) {
+            for (int i = bi; i < min(n, bi + block); i++) {
+                for (int j = max(bj, i + 1); j < min(n, bj + block); j++) swap(overlap[i][j], overlap[j][i]);
             }
         }
     }
+    for (int i = 0; i < n; i++) overlap[i][i] = 0;
     return overlap;
 }
 
+// Sparse overlap graph: every string keeps its k largest outgoing and k
+// largest incoming overlaps, the union of those edges is stored twice in
+// CSR form, by source and by target, each list sorted by decreasing
+// overlap. Missing pairs count as overlap 0.
+struct OverlapGraph {
+    int n = 0;
+    vector<uint32_t> outStart, inStart;
+    vector<int> outTarget, inSource;
+    vector<uint32_t> outOverlap, inOverlap;
+
+    int overlap(int i, int j) const {
+        for (uint32_t e = outStart[i]; e < outStart[i + 1]; e++) {
+            if (outTarget[e] == j) return outOverlap[e];
+        }
+        return 0;
+    }
+};
+
+// The dense matrix is used up to this many strings (64 MB), the top-k
+// graph above it
+const int kDenseOverlapMaxStrings = 4096;
+const int kTopOverlaps = 8;
+
+// The saved stack of the overlap DFS is ordered by depth, so read from the
+// top its first occurrences of each string come in decreasing overlap and
+// a column stops after k of them: O(sum L + k n) instead of touching every
+// nonzero pair. On the reversed strings the columns are rows, which gives
+// the outgoing lists the same way.
+OverlapGraph buildOverlapGraph(const vector<string>& strings, int k) {
+    int n = strings.size();
+    OverlapGraph graph;
+    graph.n = n;
+    graph.outStart.assign(n + 1, 0);
+    graph.inStart.assign(n + 1, 0);
+    if (n == 0) return graph;
+
+    struct Edge { int from, to, overlap; };
+    vector<Edge> edges;
+    vector<int> seen(n);
+    auto collectTop = [&](const vector<string>& source, bool reversed) {
+        fill(seen.begin(), seen.end(), -1);
+        forEachOverlapColumn(source, [&](int j, const vector<int>& best, const vector<pair<int, int>>& saved) {
+            int taken = 0;
+            for (size_t t = saved.size(); t-- > 0 && taken < k;) {
+                int i = saved[t].first;
+                if (i == j || seen[i] == j) continue;
+                seen[i] = j;
+                taken++;
+                if (reversed) {
+                    edges.push_back({j, i, best[i]});
+                } else {
+                    edges.push_back({i, j, best[i]});
+                }
+            }
+        });
+    };
+    collectTop(strings, false);
+    vector<string> reversedStrings(strings);
+    for (auto& s : reversedStrings) reverse(s.begin(), s.end());
+    collectTop(reversedStrings, true);
+
+    sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) {
+        if (a.from != b.from) return a.from < b.from;
+        return a.overlap != b.overlap ? a.overlap > b.overlap : a.to < b.to;
+    });
+    edges.erase(unique(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) {
+        return a.from == b.from && a.to == b.to;
+    }), edges.end());
+    for (const auto& e : edges) {
+        graph.outStart[e.from + 1]++;
+        graph.outTarget.push_back(e.to);
+        graph.outOverlap.push_back(e.overlap);
+    }
+
+    sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) {
+        if (a.to != b.to) return a.to < b.to;
+        return a.overlap != b.overlap ? a.overlap > b.overlap : a.from < b.from;
+    });
+    for (const auto& e : edges) {
+        graph.inStart[e.to + 1]++;
+        graph.inSource.push_back(e.from);
+        graph.inOverlap.push_back(e.overlap);
+    }
+
+    for (int i = 0; i < n; i++) {
+        graph.outStart[i + 1] += graph.outStart[i];
+        graph.inStart[i + 1] += graph.inStart[i];
+    }
+    return graph;
+}
+
 bool validateResult(const vector<string>& strings, const string& result) {
     for (const auto& s : strings) {
         if (result.find(s) == string::npos) {
@@ -105,115 +354,362 @@ string mergePath(const vector<string>& strings, const vector<int>& path,
     string result = strings[path[0]];
     for (size_t i = 1; i < path.size(); i++) {
         int ovl = overlap[path[i-1]][path[i]];
-        result = mergeWithOverlap(result, strings[path[i]], ovl);
+        result.append(strings[path[i]], ovl, string::npos);
     }
     return result;
 }
 
-string dpBitmask(const vector<string>& strings) {
-    int n = strings.size();
-    if (n == 0) return "";
-    if (n == 1) return strings[0];
-    if (n > 18) return "";
-    
-    auto overlap = buildOverlapMatrix(strings);
-    
-    int fullMask = (1 << n) - 1;
-    vector<vector<int>> dp(1 << n, vector<int>(n, 1e9));
-    vector<vector<int>> parent(1 << n, vector<int>(n, -1));
+string mergePath(const vector<string>& strings, const vector<int>& path,
+                 const OverlapGraph& graph) {
+    if (path.empty()) return "";
     
-    for (int i = 0; i < n; i++) {
-        dp[1 << i][i] = strings[i].length();
+    string result = strings[path[0]];
+    for (size_t i = 1; i < path.size(); i++) {
+        result.append(strings[path[i]], graph.overlap(path[i-1], path[i]), string::npos);
     }
-    
-    for (int mask = 0; mask <= fullMask; mask++) {
-        for (int i = 0; i < n; i++) {
-            if (!(mask & (1 << i)) || dp[mask][i] == 1e9) continue;
-            
-            for (int j = 0; j < n; j++) {
-                if (mask & (1 << j)) continue;
-                
-                int newMask = mask | (1 << j);
-                int newLen = dp[mask][i] + (int)strings[j].length() - overlap[i][j];
-                
-                if (newLen < dp[newMask][j]) {
-                    dp[newMask][j] = newLen;
-                    parent[newMask][j] = i;
-                }
+    return result;
+}
+
+int defaultThreads() {
+    return max(1u, thread::hardware_concurrency());
+}
+
+// Work-stealing pool. Every thread owns a deque of tasks, takes its own
+// from the back and steals from the front of the others'. parallelFor can
+// be called from inside a task: the caller keeps running tasks until its
+// own batch is done, so nested loops (DP layers inside cluster solves)
+// never block a worker. Queue 0 belongs to the thread outside the pool.
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(int threads) {
+        for (int t = 0; t < max(1, threads); t++) queues_.push_back(make_unique<Queue>());
+        for (int t = 1; t < (int)queues_.size(); t++) {
+            workers_.emplace_back([this, t]() { workerLoop(t); });
+        }
+    }
+
+    ~WorkStealingPool() {
+        {
+            lock_guard<mutex> guard(sleepLock_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& worker : workers_) worker.join();
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    template <class Task>
+    void parallelFor(int count, const Task& task) {
+        if (workers_.empty() || count <= 1) {
+            for (int i = 0; i < count; i++) task(i);
+            return;
+        }
+
+        int self = currentPool_ == this ? currentQueue_ : 0;
+        atomic<int> remaining(count);
+        {
+            // Pushed in reverse, so the owner runs them in index order
+            lock_guard<mutex> guard(queues_[self]->lock);
+            for (int i = count - 1; i >= 0; i--) {
+                queues_[self]->tasks.push_back([this, &task, &remaining, i]() {
+                    task(i);
+                    if (--remaining == 0) {
+                        // Taking the lock orders this with a waiter that
+                        // has just checked `remaining` and is about to sleep
+                        lock_guard<mutex> guard(sleepLock_);
+                    }
+                    wake_.notify_all();
+                });
             }
         }
+        {
+            lock_guard<mutex> guard(sleepLock_);
+            queued_ += count;
+        }
+        wake_.notify_all();
+
+        // Help until nothing is left to steal, then sleep until the batch
+        // is done or new tasks (e.g. nested loops of thieves) show up
+        while (remaining > 0) {
+            if (runOne(self)) continue;
+            unique_lock<mutex> guard(sleepLock_);
+            wake_.wait(guard, [&]() { return remaining == 0 || queued_ > 0; });
+        }
     }
-    
-    int bestLen = 1e9;
-    int lastIdx = -1;
+
+private:
+    struct Queue {
+        mutex lock;
+        deque<function<void()>> tasks;
+    };
+
+    bool runOne(int self) {
+        function<void()> task;
+        {
+            lock_guard<mutex> guard(queues_[self]->lock);
+            if (!queues_[self]->tasks.empty()) {
+                task = move(queues_[self]->tasks.back());
+                queues_[self]->tasks.pop_back();
+            }
+        }
+        for (size_t k = 1; !task && k < queues_.size(); k++) {
+            Queue& victim = *queues_[(self + k) % queues_.size()];
+            lock_guard<mutex> guard(victim.lock);
+            if (!victim.tasks.empty()) {
+                task = move(victim.tasks.front());
+                victim.tasks.pop_front();
+            }
+        }
+        if (!task) return false;
+        queued_--;
+        task();
+        return true;
+    }
+
+    void workerLoop(int self) {
+        currentPool_ = this;
+        currentQueue_ = self;
+        while (true) {
+            if (runOne(self)) continue;
+            unique_lock<mutex> guard(sleepLock_);
+            wake_.wait(guard, [this]() { return stop_ || queued_ > 0; });
+            if (stop_) return;
+        }
+    }
+
+    vector<unique_ptr<Queue>> queues_;
+    vector<thread> workers_;
+    mutex sleepLock_;
+    condition_variable wake_;
+    atomic<int> queued_{0};
+    bool stop_ = false;
+
+    static thread_local WorkStealingPool* currentPool_;
+    static thread_local int currentQueue_;
+};
+
+thread_local WorkStealingPool* WorkStealingPool::currentPool_ = nullptr;
+thread_local int WorkStealingPool::currentQueue_ = 0;
+
+// --threads; read once, when the pool is first used
+int threadCount = defaultThreads();
+
+WorkStealingPool& sharedPool() {
+    static WorkStealingPool pool(threadCount);
+    return pool;
+}
+
+// 2^22 masks x 22 ends x 3 bytes is about 280 MB
+const int kMaxExactStrings = 22;
+
+// hybrid: strings per cluster (--cluster-size). Sets of up to one more
+// string are solved exactly, so 14 keeps every DP at 2^15 masks; each
+// extra string doubles the DP work per cluster.
+const int kDefaultClusterSize = 14;
+
+template <class T>
+class AlignedTable {
+public:
+    explicit AlignedTable(size_t count)
+        : data_(static_cast<T*>(::operator new(count * sizeof(T), align_val_t(64)))) {}
+    ~AlignedTable() { ::operator delete(data_, align_val_t(64)); }
+    AlignedTable(const AlignedTable&) = delete;
+    AlignedTable& operator=(const AlignedTable&) = delete;
+
+    T* row(size_t index, int width) { return data_ + index * width; }
+
+private:
+    T* data_;
+};
+
+// dp[mask][j] — shortest superstring of `mask` ending with string j.
+// Masks are filled one popcount layer at a time, each state pulls from the
+// previous layer only, so the masks of a layer are independent.
+template <class Length>
+vector<int> dpBitmaskPath(const vector<string>& strings,
+                          const vector<vector<int>>& overlap) {
+    int n = strings.size();
+    uint32_t fullMask = (1u << n) - 1;
+    size_t states = size_t(fullMask) + 1;
+
+    vector<int> len(n), ovl(n * n);
     for (int i = 0; i < n; i++) {
-        if (dp[fullMask][i] < bestLen) {
-            bestLen = dp[fullMask][i];
-            lastIdx = i;
+        len[i] = strings[i].length();
+        for (int j = 0; j < n; j++) ovl[i * n + j] = overlap[i][j];
+    }
+
+    vector<size_t> layerStart(n + 2, 0);
+    for (uint32_t mask = 0; mask <= fullMask; mask++) {
+        layerStart[__builtin_popcount(mask) + 1]++;
+    }
+    for (int k = 1; k <= n + 1; k++) layerStart[k] += layerStart[k - 1];
+    vector<uint32_t> order(states);
+    {
+        vector<size_t> fill(layerStart.begin(), layerStart.end() - 1);
+        for (uint32_t mask = 0; mask <= fullMask; mask++) {
+            order[fill[__builtin_popcount(mask)]++] = mask;
         }
     }
-    
+
+    // Only dp[mask][j] with j in mask is ever written or read
+    AlignedTable<Length> dp(states * n);
+    AlignedTable<uint8_t> parent(states * n);
+    for (int i = 0; i < n; i++) {
+        dp.row(1u << i, n)[i] = len[i];
+        parent.row(1u << i, n)[i] = 0xFF;
+    }
+
+    const size_t chunk = 2048;
+    for (int k = 2; k <= n; k++) {
+        size_t begin = layerStart[k];
+        size_t end = layerStart[k + 1];
+        int chunks = (end - begin + chunk - 1) / chunk;
+
+        sharedPool().parallelFor(chunks, [&](int c) {
+            size_t from = begin + c * chunk;
+            size_t to = min(end, from + chunk);
+            for (size_t p = from; p < to; p++) {
+                uint32_t mask = order[p];
+                Length* dpRow = dp.row(mask, n);
+                uint8_t* parentRow = parent.row(mask, n);
+
+                for (uint32_t ends = mask; ends; ends &= ends - 1) {
+                    int j = __builtin_ctz(ends);
+                    uint32_t prev = mask ^ (1u << j);
+                    const Length* prevRow = dp.row(prev, n);
+
+                    int best = numeric_limits<int>::max();
+                    int bestFrom = -1;
+                    for (uint32_t bits = prev; bits; bits &= bits - 1) {
+                        int i = __builtin_ctz(bits);
+                        int cand = prevRow[i] + len[j] - ovl[i * n + j];
+                        if (cand < best) {
+                            best = cand;
+                            bestFrom = i;
+                        }
+                    }
+                    dpRow[j] = best;
+                    parentRow[j] = bestFrom;
+                }
+            }
+        });
+    }
+
+    const Length* fullRow = dp.row(fullMask, n);
+    int lastIdx = 0;
+    for (int i = 1; i < n; i++) {
+        if (fullRow[i] < fullRow[lastIdx]) lastIdx = i;
+    }
+
     vector<int> path;
-    int mask = fullMask;
+    uint32_t mask = fullMask;
     int cur = lastIdx;
-    while (cur != -1) {
+    while (true) {
         path.push_back(cur);
-        int prev = parent[mask][cur];
-        if (prev != -1) {
-            mask ^= (1 << cur);
-        }
+        int prev = parent.row(mask, n)[cur];
+        if (prev == 0xFF) break;
+        mask ^= 1u << cur;
         cur = prev;
     }
     reverse(path.begin(), path.end());
+    return path;
+}
+
+string dpBitmask(const vector<string>& strings) {
+    int n = strings.size();
+    if (n == 0) return "";
+    if (n == 1) return strings[0];
+    if (n > kMaxExactStrings) return "";
+    
+    auto overlap = buildOverlapMatrix(strings);
+    
+    size_t totalLength = 0;
+    for (const auto& s : strings) totalLength += s.length();
+    
+    vector<int> path = totalLength < numeric_limits<uint16_t>::max()
+        ? dpBitmaskPath<uint16_t>(strings, overlap)
+        : dpBitmaskPath<uint32_t>(strings, overlap);
     
     return mergePath(strings, path, overlap);
 }
 
-string greedyWithLookahead(const vector<string>& strings, int lookAhead) {
+// Lookahead greedy: from the current string go to the unused j with the
+// largest overlap[current][j] + futureOvl(j) / 2, ties to the lower index,
+// where futureOvl(j) is j's best overlap into another unused string.
+// Both terms are kept incrementally. cursor[j] walks j's out-list past
+// used strings, so futureOvl(j) is amortised O(1), and a lazy max-heap
+// holds (futureOvl(j) / 2, -j), refreshed when a stale entry reaches the
+// top. The top is the best string outside the current out-list (overlap
+// 0), and the out-list, sorted by decreasing overlap, is walked only while
+// overlap + top can still reach the best score. O(E + n log n) for E
+// graph edges.
+string greedyWithLookahead(const vector<string>& strings, const OverlapGraph& graph, int lookAhead) {
     int n = strings.size();
     if (n == 0) return "";
     if (n == 1) return strings[0];
     
-    auto overlap = buildOverlapMatrix(strings);
     vector<bool> used(n, false);
-    vector<int> path;
+    vector<uint32_t> cursor(graph.outStart.begin(), graph.outStart.end() - 1);
+    auto futureTerm = [&](int j) {
+        if (lookAhead <= 0) return 0;
+        uint32_t& e = cursor[j];
+        while (e < graph.outStart[j + 1] && used[graph.outTarget[e]]) e++;
+        return e < graph.outStart[j + 1] ? (int)graph.outOverlap[e] / 2 : 0;
+    };
     
+    vector<int> path;
     path.push_back(0);
     used[0] = true;
     
+    priority_queue<pair<int, int>> heap;  // (futureTerm, -j)
+    for (int j = 1; j < n; j++) heap.push({futureTerm(j), -j});
+    
     for (int iter = 1; iter < n; iter++) {
-        int current = path.back();
-        int bestNext = -1;
-        int bestScore = -1e9;
+        while (true) {
+            auto [term, negJ] = heap.top();
+            if (used[-negJ]) {
+                heap.pop();
+            } else if (futureTerm(-negJ) != term) {
+                heap.pop();
+                heap.push({futureTerm(-negJ), negJ});
+            } else {
+                break;
+            }
+        }
+        int topTerm = heap.top().first;
         
-        for (int j = 0; j < n; j++) {
+        // The top scores at least topTerm; as a candidate with exactly
+        // that score it only wins when that is the true maximum
+        int current = path.back();
+        int bestNext = -heap.top().second;
+        int bestScore = topTerm;
+        for (uint32_t e = graph.outStart[current]; e < graph.outStart[current + 1]; e++) {
+            int j = graph.outTarget[e];
             if (used[j]) continue;
-            
-            int score = overlap[current][j];
-            
-            if (lookAhead > 0) {
-                int maxFutureOvl = 0;
-                for (int k = 0; k < n; k++) {
-                    if (!used[k] && k != j) {
-                        maxFutureOvl = max(maxFutureOvl, overlap[j][k]);
-                    }
-                }
-                score += maxFutureOvl / 2;
-            }
-            
-            if (score > bestScore) {
+            int ovl = graph.outOverlap[e];
+            if (ovl + topTerm < bestScore) break;
+            int score = ovl + futureTerm(j);
+            if (score > bestScore || (score == bestScore && j < bestNext)) {
                 bestScore = score;
                 bestNext = j;
             }
         }
         
-        if (bestNext != -1) {
-            path.push_back(bestNext);
-            used[bestNext] = true;
-        }
+        path.push_back(bestNext);
+        used[bestNext] = true;
     }
     
-    return mergePath(strings, path, overlap);
+    return mergePath(strings, path, graph);
+}
+
+// Small inputs keep every nonzero overlap, so the choices are those of the
+// full matrix
+string greedyWithLookahead(const vector<string>& strings, int lookAhead) {
+    int n = strings.size();
+    int k = n > kDenseOverlapMaxStrings ? kTopOverlaps : n;
+    return greedyWithLookahead(strings, buildOverlapGraph(strings, k), lookAhead);
 }
 
 string greedyBidirectional(const vector<string>& strings) {
@@ -287,8 +783,148 @@ string greedyBidirectional(const vector<string>& strings) {
     return result;
 }
 
+struct DisjointSets {
+    vector<int> parent;
+
+    explicit DisjointSets(int n) : parent(n) {
+        for (int i = 0; i < n; i++) parent[i] = i;
+    }
+
+    int find(int x) {
+        while (parent[x] != x) {
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    }
+
+    bool unite(int a, int b) {
+        a = find(a);
+        b = find(b);
+        if (a == b) return false;
+        parent[a] = b;
+        return true;
+    }
+};
+
+// Classic greedy merge (4-approximation): take the pair edges i -> j in
+// order of decreasing overlap, accept one when i has no successor yet,
+// j has no predecessor yet and it does not close a cycle. Overlaps are
+// bucket-sorted once, the strings are only glued together at the end.
+// forEachEdge(f) calls f(i, j, overlap) for every edge with overlap > 0;
+// the chains that zero-overlap edges would join are concatenated in any
+// order.
+template <class ForEachEdge>
+vector<int> greedyMergePath(int n, int maxOvl, const ForEachEdge& forEachEdge) {
+    vector<size_t> bucketStart(maxOvl + 2, 0);
+    forEachEdge([&](int, int, int ovl) { bucketStart[maxOvl - ovl + 1]++; });
+    for (int o = 1; o <= maxOvl + 1; o++) bucketStart[o] += bucketStart[o - 1];
+    vector<pair<int, int>> edges(bucketStart[maxOvl + 1]);
+    forEachEdge([&](int i, int j, int ovl) { edges[bucketStart[maxOvl - ovl]++] = {i, j}; });
+    
+    vector<int> next(n, -1);
+    vector<bool> hasPrev(n, false);
+    DisjointSets chains(n);
+    int accepted = 0;
+    for (const auto& [i, j] : edges) {
+        if (next[i] != -1 || hasPrev[j] || !chains.unite(i, j)) continue;
+        next[i] = j;
+        hasPrev[j] = true;
+        if (++accepted == n - 1) break;
+    }
+    
+    vector<int> path;
+    path.reserve(n);
+    for (int head = 0; head < n; head++) {
+        if (hasPrev[head]) continue;
+        for (int cur = head; cur != -1; cur = next[cur]) path.push_back(cur);
+    }
+    return path;
+}
+
+string greedyMerge(const vector<string>& strings, const OverlapGraph& graph) {
+    int n = strings.size();
+    if (n == 0) return "";
+    if (n == 1) return strings[0];
+    
+    int maxOvl = 0;
+    for (uint32_t ovl : graph.outOverlap) maxOvl = max(maxOvl, (int)ovl);
+    
+    auto path = greedyMergePath(n, maxOvl, [&](auto&& f) {
+        for (int i = 0; i < n; i++) {
+            for (uint32_t e = graph.outStart[i]; e < graph.outStart[i + 1]; e++) {
+                f(i, graph.outTarget[e], graph.outOverlap[e]);
+            }
+        }
+    });
+    return mergePath(strings, path, graph);
+}
+
+string greedyMerge(const vector<string>& strings) {
+    int n = strings.size();
+    if (n > kDenseOverlapMaxStrings) return greedyMerge(strings, buildOverlapGraph(strings, kTopOverlaps));
+    if (n == 0) return "";
+    if (n == 1) return strings[0];
+    
+    auto overlap = buildOverlapMatrix(strings);
+    
+    int maxOvl = 0;
+    for (const auto& s : strings) maxOvl = max(maxOvl, (int)s.length());
+    
+    auto path = greedyMergePath(n, maxOvl, [&](auto&& f) {
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                if (overlap[i][j] > 0) f(i, j, overlap[i][j]);
+            }
+        }
+    });
+    return mergePath(strings, path, overlap);
+}
+
+// cursor[i] walks i's out-list past used strings, so the first entry it
+// points to is i's best remaining overlap
+vector<vector<int>> partitionIntoClusters(const OverlapGraph& graph, int maxClusterSize) {
+    int n = graph.n;
+    vector<bool> used(n, false);
+    vector<uint32_t> cursor(graph.outStart.begin(), graph.outStart.end() - 1);
+    vector<vector<int>> clusters;
+    
+    for (int start = 0; start < n; start++) {
+        if (used[start]) continue;
+        
+        vector<int> cluster;
+        cluster.push_back(start);
+        used[start] = true;
+        
+        while ((int)cluster.size() < maxClusterSize) {
+            int bestNext = -1;
+            int bestOvl = 0;
+            
+            for (int i : cluster) {
+                uint32_t& e = cursor[i];
+                while (e < graph.outStart[i + 1] && used[graph.outTarget[e]]) e++;
+                if (e < graph.outStart[i + 1] && (int)graph.outOverlap[e] > bestOvl) {
+                    bestOvl = graph.outOverlap[e];
+                    bestNext = graph.outTarget[e];
+                }
+            }
+            
+            if (bestNext == -1) break;
+            cluster.push_back(bestNext);
+            used[bestNext] = true;
+        }
+        
+        clusters.push_back(cluster);
+    }
+    
+    return clusters;
+}
+
 vector<vector<int>> partitionIntoClusters(const vector<string>& strings, int maxClusterSize) {
     int n = strings.size();
+    if (n > kDenseOverlapMaxStrings) {
+        return partitionIntoClusters(buildOverlapGraph(strings, kTopOverlaps), maxClusterSize);
+    }
     auto overlap = buildOverlapMatrix(strings);
     
     vector<bool> used(n, false);
@@ -325,31 +961,33 @@ vector<vector<int>> partitionIntoClusters(const vector<string>& strings, int max
     return clusters;
 }
 
-string solveCluster(const vector<string>& clusterStrings) {
-    if (clusterStrings.size() <= 15) {
+string solveCluster(const vector<string>& clusterStrings, int exactLimit) {
+    if (clusterStrings.size() <= (size_t)exactLimit) {
         return dpBitmask(clusterStrings);
     }
     return greedyWithLookahead(clusterStrings, 2);
 }
 
-string hybridClusterDP(const vector<string>& strings) {
+string hybridClusterDP(const vector<string>& strings, int clusterSize = kDefaultClusterSize) {
     int n = strings.size();
+    int exactLimit = min(clusterSize + 1, kMaxExactStrings);
     if (n == 0) return "";
-    if (n <= 15) return dpBitmask(strings);
+    if (n <= exactLimit) return dpBitmask(strings);
     
-    const int clusterSize = 14;
     auto clusters = partitionIntoClusters(strings, clusterSize);
     
-    vector<string> clusterResults;
-    for (const auto& cluster : clusters) {
+    // Each result goes to its own slot, so the output does not depend on
+    // the thread count
+    vector<string> clusterResults(clusters.size());
+    sharedPool().parallelFor(clusters.size(), [&](int c) {
         vector<string> clusterStrings;
-        for (int idx : cluster) {
+        for (int idx : clusters[c]) {
             clusterStrings.push_back(strings[idx]);
         }
-        clusterResults.push_back(solveCluster(clusterStrings));
-    }
+        clusterResults[c] = solveCluster(clusterStrings, exactLimit);
+    });
     
-    if (clusterResults.size() <= 15) {
+    if (clusterResults.size() <= (size_t)exactLimit) {
         return dpBitmask(clusterResults);
     }
     return greedyWithLookahead(clusterResults, 3);
@@ -357,14 +995,40 @@ string hybridClusterDP(const vector<string>& strings) {
 
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        cerr << "Usage: " << argv[0] << " <algorithm> [input_file] [output_file]" << endl;
-        cerr << "Algorithms: lookahead, bidirectional, hybrid" << endl;
+        cerr << "Usage: " << argv[0] << " <algorithm> [input_file] [output_file] [--threads N] [--cluster-size N]" << endl;
+        cerr << "Algorithms: lookahead, bidirectional, greedy, hybrid" << endl;
         return 1;
     }
     
     string algorithm = argv[1];
-    string input_file = (argc >= 3) ? argv[2] : "input.txt";
-    string output_file = (argc >= 4) ? argv[3] : "output.txt";
+    int clusterSize = kDefaultClusterSize;
+    vector<string> positional;
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--threads") {
+            char* end = nullptr;
+            long value = i + 1 < argc ? strtol(argv[i + 1], &end, 10) : 0;
+            if (i + 1 >= argc || *end != '\0' || value < 1 || value > 1024) {
+                cerr << "Error: --threads expects a number from 1 to 1024" << endl;
+                return 1;
+            }
+            threadCount = value;
+            i++;
+        } else if (arg == "--cluster-size") {
+            char* end = nullptr;
+            long value = i + 1 < argc ? strtol(argv[i + 1], &end, 10) : 0;
+            if (i + 1 >= argc || *end != '\0' || value < 2 || value >= kMaxExactStrings) {
+                cerr << "Error: --cluster-size expects a number from 2 to " << kMaxExactStrings - 1 << endl;
+                return 1;
+            }
+            clusterSize = value;
+            i++;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    string input_file = positional.size() >= 1 ? positional[0] : "input.txt";
+    string output_file = positional.size() >= 2 ? positional[1] : "output.txt";
     
     auto start = high_resolution_clock::now();
     
@@ -381,8 +1045,10 @@ int main(int argc, char* argv[]) {
         result = greedyWithLookahead(cleaned, 3);
     } else if (algorithm == "bidirectional") {
         result = greedyBidirectional(cleaned);
+    } else if (algorithm == "greedy") {
+        result = greedyMerge(cleaned);
     } else if (algorithm == "hybrid") {
-        result = hybridClusterDP(cleaned);
+        result = hybridClusterDP(cleaned, clusterSize);
     } else {
         cerr << "Unknown algorithm: " << algorithm << endl;
         return 1;
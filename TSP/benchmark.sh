@@ -9,7 +9,14 @@ ALGORITHMS=(
   2approx
   15approx_improved
   nn
+  hilbert
   nn_2opt
+  multi_nn_2opt
+  nn_2opt_3opt
+  ils
+  christofides_full
+  multi_nn_full
+  partition
 )
 
 echo "Building..."
@@ -23,12 +30,15 @@ fi
 
 mkdir -p "$RESULTS_DIR"
 
+# Parse the text input once, every run loads the binary snapshot
+"$BIN" convert "$INPUT" "$RESULTS_DIR/input.bin"
+
 run_algo() {
   local algo=$1
   local out="$RESULTS_DIR/output_${algo}.txt"
 
   echo "Running $algo..."
-  "$BIN" "$algo" "$INPUT" "$out"
+  "$BIN" "$algo" "$RESULTS_DIR/input.bin" "$out"
   echo "Output saved to $out"
 }
 
@@ -7,7 +7,29 @@
 #include <chrono>
 #include <iomanip>
 #include <unordered_map>
+#include <unordered_set>
 #include <limits>
+#include <deque>
+#include <queue>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <array>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <charconv>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 using namespace std;
 using namespace std::chrono;
@@ -19,317 +41,3742 @@ struct Point {
     Point(int id, double x, double y) : id(id), x(x), y(y) {}
 };
 
+// ============================================================================
+// METRICS
+// ============================================================================
+
+// Instrumentation behind --metrics: scoped phase timers, event counters and
+// a trace of the best tour length over time. When it is off every hook is
+// a single test of metrics.enabled.
+enum Counter {
+    kDistanceEvaluations,
+    kMovesTried,
+    kMovesApplied,
+    kSearchRuns,
+    kKicks,
+    kCounterCount
+};
+
+const char* const kCounterNames[kCounterCount] = {
+    "distance_evaluations", "moves_tried", "moves_applied", "local_search_runs", "kicks"};
+
+struct Metrics {
+    bool enabled = false;
+    int points = 0;  // size of the instance, tours of sub-problems are not traced
+    steady_clock::time_point start = steady_clock::now();
+    array<atomic<long long>, kCounterCount> counters{};
+
+    mutex lock;
+    vector<string> phaseNames;
+    vector<double> phaseMs;
+    vector<long long> phaseCalls;
+    vector<pair<double, double>> trace;  // (ms since start, best length)
+
+    double elapsedMs() const {
+        return duration<double, milli>(steady_clock::now() - start).count();
+    }
+
+    void addPhase(const char* name, double ms) {
+        lock_guard<mutex> guard(lock);
+        int i = find(phaseNames.begin(), phaseNames.end(), name) - phaseNames.begin();
+        if (i == (int)phaseNames.size()) {
+            phaseNames.push_back(name);
+            phaseMs.push_back(0);
+            phaseCalls.push_back(0);
+        }
+        phaseMs[i] += ms;
+        phaseCalls[i]++;
+    }
+
+    void addLength(double length) {
+        lock_guard<mutex> guard(lock);
+        if (trace.empty() || length < trace.back().second) trace.push_back({elapsedMs(), length});
+    }
+};
+
+Metrics metrics;
+
+// Counters are summed per thread and added to metrics.counters when the
+// thread exits; the main thread calls flush() before writing the report.
+struct ThreadCounters {
+    array<long long, kCounterCount> value{};
+
+    void flush() {
+        for (int i = 0; i < kCounterCount; i++) {
+            metrics.counters[i] += value[i];
+            value[i] = 0;
+        }
+    }
+
+    ~ThreadCounters() { flush(); }
+};
+
+thread_local ThreadCounters threadCounters;
+
+inline void countEvent(Counter counter, long long amount = 1) {
+    if (metrics.enabled) threadCounters.value[counter] += amount;
+}
+
+// Adds the lifetime of the object to the named phase. Phases run by
+// several threads add up their times.
+class ScopedPhase {
+public:
+    explicit ScopedPhase(const char* name) : name(name) {
+        if (metrics.enabled) begin = steady_clock::now();
+    }
+
+    ~ScopedPhase() {
+        if (metrics.enabled) {
+            metrics.addPhase(name, duration<double, milli>(steady_clock::now() - begin).count());
+        }
+    }
+
+private:
+    const char* name;
+    steady_clock::time_point begin;
+};
+
+struct RunTimes {
+    long long readMs, algorithmMs, writeMs, totalMs;
+};
+
+void writeMetrics(const string& filename, const string& algorithm, int n, double length,
+                  const RunTimes& times) {
+    ofstream file(filename);
+    if (!file.is_open()) {
+        cerr << "Cannot open file for writing: " << filename << endl;
+        exit(1);
+    }
+
+    threadCounters.flush();
+    file << fixed << setprecision(3);
+    file << "{\n";
+    file << "  \"algorithm\": \"" << algorithm << "\",\n";
+    file << "  \"points\": " << n << ",\n";
+    file << "  \"tour_length\": " << length << ",\n";
+    file << "  \"times_ms\": {\"read\": " << times.readMs << ", \"algorithm\": " << times.algorithmMs
+         << ", \"write\": " << times.writeMs << ", \"total\": " << times.totalMs << "},\n";
+
+    file << "  \"phases\": [";
+    for (size_t i = 0; i < metrics.phaseNames.size(); i++) {
+        file << (i ? ",\n" : "\n") << "    {\"name\": \"" << metrics.phaseNames[i]
+             << "\", \"ms\": " << metrics.phaseMs[i] << ", \"calls\": " << metrics.phaseCalls[i] << "}";
+    }
+    file << "\n  ],\n";
+
+    file << "  \"counters\": {";
+    for (int i = 0; i < kCounterCount; i++) {
+        file << (i ? ", " : "") << "\"" << kCounterNames[i] << "\": " << metrics.counters[i].load();
+    }
+    file << "},\n";
+
+    file << "  \"trace\": [";
+    for (size_t i = 0; i < metrics.trace.size(); i++) {
+        file << (i ? ", " : "") << "[" << metrics.trace[i].first << ", " << metrics.trace[i].second << "]";
+    }
+    file << "]\n}\n";
+}
+
 inline double distance(const Point& p1, const Point& p2) {
     double dx = p1.x - p2.x;
     double dy = p1.y - p2.y;
     return sqrt(dx * dx + dy * dy);
 }
 
-vector<Point> readPoints(const string& filename) {
-    ifstream file(filename);
-    if (!file.is_open()) {
-        cerr << "Cannot open file: " << filename << endl;
+// Read-only mapping of a whole file, unmapped on destruction
+class MappedFile {
+public:
+    explicit MappedFile(const string& filename) {
+        fd = open(filename.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            cerr << "Cannot open file: " << filename << endl;
+            exit(1);
+        }
+        length = st.st_size;
+        if (length > 0) {
+            void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                cerr << "Cannot map file: " << filename << endl;
+                exit(1);
+            }
+            bytes = static_cast<const char*>(mapped);
+        }
+    }
+
+    ~MappedFile() {
+        if (bytes) munmap(const_cast<char*>(bytes), length);
+        if (fd >= 0) close(fd);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    int fd = -1;
+    const char* bytes = nullptr;
+    size_t length = 0;
+};
+
+// Binary snapshot: header, then x[count] and y[count] as doubles and
+// id[count] as int32, in the byte order of the machine that wrote it.
+struct BinaryHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t count;
+};
+
+const char kBinaryMagic[4] = {'T', 'S', 'P', 'B'};
+const uint32_t kBinaryVersion = 1;
+
+vector<Point> parseBinaryPoints(const MappedFile& file, const string& filename) {
+    BinaryHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+    size_t n = header.count;
+    if (header.version != kBinaryVersion ||
+        file.size() != sizeof(header) + n * (2 * sizeof(double) + sizeof(int32_t))) {
+        cerr << "Bad binary point file: " << filename << endl;
         exit(1);
     }
-    
+
+    const double* xs = reinterpret_cast<const double*>(file.data() + sizeof(header));
+    const double* ys = xs + n;
+    const int32_t* ids = reinterpret_cast<const int32_t*>(ys + n);
     vector<Point> points;
-    string line;
-    while (getline(file, line)) {
-        if (line.empty()) continue;
-        istringstream iss(line);
+    points.reserve(n);
+    for (size_t i = 0; i < n; i++) points.push_back(Point(ids[i], xs[i], ys[i]));
+    return points;
+}
+
+// "id x y" per line; lines that do not start with those three numbers are
+// skipped, as with the old istringstream parser.
+vector<Point> parseTextPoints(const char* p, const char* end) {
+    vector<Point> points;
+    auto skipBlanks = [&](const char* q, const char* stop) {
+        while (q < stop && (*q == ' ' || *q == '\t' || *q == '\r' || *q == '+')) q++;
+        return q;
+    };
+    while (p < end) {
+        const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (!eol) eol = end;
+
         int id;
         double x, y;
-        if (iss >> id >> x >> y) {
-            points.push_back(Point(id, x, y));
-        }
+        auto r = from_chars(skipBlanks(p, eol), eol, id);
+        if (r.ec == errc()) r = from_chars(skipBlanks(r.ptr, eol), eol, x);
+        if (r.ec == errc()) r = from_chars(skipBlanks(r.ptr, eol), eol, y);
+        if (r.ec == errc()) points.push_back(Point(id, x, y));
+
+        p = eol + 1;
     }
-    
     return points;
 }
 
-void writeTour(const string& filename, const vector<int>& tour) {
-    ofstream file(filename);
-    if (!file.is_open()) {
-        cerr << "Cannot open file for writing: " << filename << endl;
-        exit(1);
-    }
-    
-    for (int v : tour) {
-        file << v << "\n";
+// Text or binary, told apart by the magic bytes
+vector<Point> readPoints(const string& filename) {
+    MappedFile file(filename);
+    if (file.size() >= sizeof(BinaryHeader) && memcmp(file.data(), kBinaryMagic, 4) == 0) {
+        return parseBinaryPoints(file, filename);
+    }
+    return parseTextPoints(file.data(), file.data() + file.size());
+}
+
+void writeBinaryPoints(const string& filename, const vector<Point>& points) {
+    ofstream file(filename, ios::binary);
+    if (!file.is_open()) {
+        cerr << "Cannot open file for writing: " << filename << endl;
+        exit(1);
+    }
+
+    BinaryHeader header;
+    memcpy(header.magic, kBinaryMagic, 4);
+    header.version = kBinaryVersion;
+    header.count = points.size();
+    vector<double> xs, ys;
+    vector<int32_t> ids;
+    for (const auto& p : points) {
+        xs.push_back(p.x);
+        ys.push_back(p.y);
+        ids.push_back(p.id);
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(xs.data()), xs.size() * sizeof(double));
+    file.write(reinterpret_cast<const char*>(ys.data()), ys.size() * sizeof(double));
+    file.write(reinterpret_cast<const char*>(ids.data()), ids.size() * sizeof(int32_t));
+}
+
+void writeTour(const string& filename, const vector<int>& tour) {
+    ofstream file(filename, ios::binary);
+    if (!file.is_open()) {
+        cerr << "Cannot open file for writing: " << filename << endl;
+        exit(1);
+    }
+
+    string buffer(tour.size() * 12, '\0');
+    char* out = buffer.data();
+    for (int v : tour) {
+        out = to_chars(out, buffer.data() + buffer.size(), v).ptr;
+        *out++ = '\n';
+    }
+    file.write(buffer.data(), out - buffer.data());
+}
+
+double tourLength(const vector<Point>& points, const vector<int>& tour) {
+    double total = 0.0;
+    int n = tour.size();
+    for (int i = 0; i < n; i++) {
+        total += distance(points[tour[i]], points[tour[(i + 1) % n]]);
+    }
+    return total;
+}
+
+// Adds the tour to the --metrics length trace
+void traceTour(const vector<Point>& points, const vector<int>& tour) {
+    if (metrics.enabled && (int)tour.size() == metrics.points) metrics.addLength(tourLength(points, tour));
+}
+
+vector<int> tourIndicesToIds(const vector<Point>& points, const vector<int>& tour) {
+    vector<int> result;
+    result.reserve(tour.size());
+    for (int idx : tour) {
+        result.push_back(points[idx].id);
+    }
+    return result;
+}
+
+// ============================================================================
+// SIMD KERNELS
+// ============================================================================
+
+// Structure-of-arrays copy of the coordinates for the brute-force scans.
+// Only the prefix [0, size()) is live: remove() swaps a point with the last
+// live one, and idx keeps the original point index of every slot.
+struct Coordinates {
+    vector<double> x, y, idx;
+
+    explicit Coordinates(const vector<Point>& points)
+        : x(points.size()), y(points.size()), idx(points.size()), live(points.size()) {
+        for (int i = 0; i < live; i++) {
+            x[i] = points[i].x;
+            y[i] = points[i].y;
+            idx[i] = i;
+        }
+    }
+
+    int size() const { return live; }
+
+    void remove(int slot) {
+        live--;
+        swap(x[slot], x[live]);
+        swap(y[slot], y[live]);
+        swap(idx[slot], idx[live]);
+    }
+
+private:
+    int live;
+};
+
+// relaxArgmin: key[j] = min(key[j], |p - point j|^2), from[j] = source where
+// the key dropped, returns the first slot with the smallest key (Prim step).
+// nearestSquared: slot of the point closest to p, ties broken by the
+// smaller idx, so it agrees with KdTree::nearest.
+// Both exist in scalar, SSE2, AVX2 and AVX-512 versions, picked at runtime.
+// They only serve the dense Prim fallback and nearest-neighbour tours of up
+// to 2048 points; under -march=native the pick is the build machine's ISA.
+// Sums are plain mul+add, and the Makefile disables FP contraction, so the
+// kernels and the scalar k-d tree round the same way.
+using RelaxArgminKernel = int (*)(const double*, const double*, double*, double*, int,
+                                  double, double, double);
+using NearestKernel = int (*)(const double*, const double*, const double*, int, double, double);
+
+int relaxArgminScalar(const double* x, const double* y, double* key, double* from, int m,
+                      double px, double py, double source) {
+    int best = -1;
+    double bestKey = numeric_limits<double>::infinity();
+    for (int j = 0; j < m; j++) {
+        double dx = x[j] - px, dy = y[j] - py;
+        double d = dx * dx + dy * dy;
+        if (d < key[j]) {
+            key[j] = d;
+            from[j] = source;
+        }
+        if (key[j] < bestKey) {
+            bestKey = key[j];
+            best = j;
+        }
+    }
+    return best;
+}
+
+int nearestSquaredScalar(const double* x, const double* y, const double* idx, int m,
+                         double px, double py) {
+    int best = -1;
+    double bestDist = numeric_limits<double>::infinity(), bestIdx = 0;
+    for (int j = 0; j < m; j++) {
+        double dx = x[j] - px, dy = y[j] - py;
+        double d = dx * dx + dy * dy;
+        if (d < bestDist || (d == bestDist && idx[j] < bestIdx)) {
+            bestDist = d;
+            bestIdx = idx[j];
+            best = j;
+        }
+    }
+    return best;
+}
+
+#if defined(__x86_64__)
+
+// Lane results of the vector loops: lane l covers slots l, l + W, ...
+// Picks the smallest (value, tie) pair; for relaxArgmin tie is the slot.
+inline int reduceLanes(const double* value, const double* tie, const double* slot, int lanes) {
+    int best = 0;
+    for (int l = 1; l < lanes; l++) {
+        if (value[l] < value[best] || (value[l] == value[best] && tie[l] < tie[best])) best = l;
+    }
+    return slot[best] < 0 ? -1 : (int)slot[best];
+}
+
+__attribute__((target("sse2")))
+int relaxArgminSse2(const double* x, const double* y, double* key, double* from, int m,
+                    double px, double py, double source) {
+    __m128d vpx = _mm_set1_pd(px), vpy = _mm_set1_pd(py), vsrc = _mm_set1_pd(source);
+    __m128d best = _mm_set1_pd(numeric_limits<double>::infinity());
+    __m128d bestSlot = _mm_set1_pd(-1), slot = _mm_setr_pd(0, 1), step = _mm_set1_pd(2);
+    int j = 0;
+    for (; j + 2 <= m; j += 2) {
+        __m128d dx = _mm_sub_pd(_mm_loadu_pd(x + j), vpx);
+        __m128d dy = _mm_sub_pd(_mm_loadu_pd(y + j), vpy);
+        __m128d d = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+        __m128d k = _mm_loadu_pd(key + j);
+        __m128d lt = _mm_cmplt_pd(d, k);
+        k = _mm_or_pd(_mm_and_pd(lt, d), _mm_andnot_pd(lt, k));
+        __m128d f = _mm_loadu_pd(from + j);
+        _mm_storeu_pd(key + j, k);
+        _mm_storeu_pd(from + j, _mm_or_pd(_mm_and_pd(lt, vsrc), _mm_andnot_pd(lt, f)));
+        __m128d better = _mm_cmplt_pd(k, best);
+        best = _mm_or_pd(_mm_and_pd(better, k), _mm_andnot_pd(better, best));
+        bestSlot = _mm_or_pd(_mm_and_pd(better, slot), _mm_andnot_pd(better, bestSlot));
+        slot = _mm_add_pd(slot, step);
+    }
+    alignas(16) double value[2], slots[2];
+    _mm_store_pd(value, best);
+    _mm_store_pd(slots, bestSlot);
+    int result = reduceLanes(value, slots, slots, 2);
+    int tail = relaxArgminScalar(x + j, y + j, key + j, from + j, m - j, px, py, source);
+    if (tail >= 0 && (result < 0 || key[j + tail] < key[result])) result = j + tail;
+    return result;
+}
+
+__attribute__((target("avx2")))
+int relaxArgminAvx2(const double* x, const double* y, double* key, double* from, int m,
+                    double px, double py, double source) {
+    __m256d vpx = _mm256_set1_pd(px), vpy = _mm256_set1_pd(py), vsrc = _mm256_set1_pd(source);
+    __m256d best = _mm256_set1_pd(numeric_limits<double>::infinity());
+    __m256d bestSlot = _mm256_set1_pd(-1), slot = _mm256_setr_pd(0, 1, 2, 3);
+    __m256d step = _mm256_set1_pd(4);
+    int j = 0;
+    for (; j + 4 <= m; j += 4) {
+        __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + j), vpx);
+        __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(y + j), vpy);
+        __m256d d = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+        __m256d k = _mm256_loadu_pd(key + j);
+        __m256d lt = _mm256_cmp_pd(d, k, _CMP_LT_OQ);
+        k = _mm256_blendv_pd(k, d, lt);
+        _mm256_storeu_pd(key + j, k);
+        _mm256_storeu_pd(from + j, _mm256_blendv_pd(_mm256_loadu_pd(from + j), vsrc, lt));
+        __m256d better = _mm256_cmp_pd(k, best, _CMP_LT_OQ);
+        best = _mm256_blendv_pd(best, k, better);
+        bestSlot = _mm256_blendv_pd(bestSlot, slot, better);
+        slot = _mm256_add_pd(slot, step);
+    }
+    alignas(32) double value[4], slots[4];
+    _mm256_store_pd(value, best);
+    _mm256_store_pd(slots, bestSlot);
+    int result = reduceLanes(value, slots, slots, 4);
+    int tail = relaxArgminScalar(x + j, y + j, key + j, from + j, m - j, px, py, source);
+    if (tail >= 0 && (result < 0 || key[j + tail] < key[result])) result = j + tail;
+    return result;
+}
+
+__attribute__((target("avx512f")))
+int relaxArgminAvx512(const double* x, const double* y, double* key, double* from, int m,
+                      double px, double py, double source) {
+    __m512d vpx = _mm512_set1_pd(px), vpy = _mm512_set1_pd(py), vsrc = _mm512_set1_pd(source);
+    __m512d best = _mm512_set1_pd(numeric_limits<double>::infinity());
+    __m512d bestSlot = _mm512_set1_pd(-1), slot = _mm512_setr_pd(0, 1, 2, 3, 4, 5, 6, 7);
+    __m512d step = _mm512_set1_pd(8);
+    int j = 0;
+    for (; j + 8 <= m; j += 8) {
+        __m512d dx = _mm512_sub_pd(_mm512_loadu_pd(x + j), vpx);
+        __m512d dy = _mm512_sub_pd(_mm512_loadu_pd(y + j), vpy);
+        __m512d d = _mm512_add_pd(_mm512_mul_pd(dx, dx), _mm512_mul_pd(dy, dy));
+        __m512d k = _mm512_loadu_pd(key + j);
+        __mmask8 lt = _mm512_cmp_pd_mask(d, k, _CMP_LT_OQ);
+        k = _mm512_mask_blend_pd(lt, k, d);
+        _mm512_storeu_pd(key + j, k);
+        _mm512_mask_storeu_pd(from + j, lt, vsrc);
+        __mmask8 better = _mm512_cmp_pd_mask(k, best, _CMP_LT_OQ);
+        best = _mm512_mask_blend_pd(better, best, k);
+        bestSlot = _mm512_mask_blend_pd(better, bestSlot, slot);
+        slot = _mm512_add_pd(slot, step);
+    }
+    alignas(64) double value[8], slots[8];
+    _mm512_store_pd(value, best);
+    _mm512_store_pd(slots, bestSlot);
+    int result = reduceLanes(value, slots, slots, 8);
+    int tail = relaxArgminScalar(x + j, y + j, key + j, from + j, m - j, px, py, source);
+    if (tail >= 0 && (result < 0 || key[j + tail] < key[result])) result = j + tail;
+    return result;
+}
+
+// The nearest-point scans finish with nearestSquaredScalar on the tail and
+// then compare (distance, idx) against the vector lanes.
+inline int mergeNearestTail(const double* x, const double* y, const double* idx, int m, int j,
+                            double px, double py, const double* value, const double* ids,
+                            const double* slots, int lanes) {
+    int result = reduceLanes(value, ids, slots, lanes);
+    int tail = nearestSquaredScalar(x + j, y + j, idx + j, m - j, px, py);
+    if (tail < 0) return result;
+    if (result < 0) return j + tail;
+    double dx = x[j + tail] - px, dy = y[j + tail] - py;
+    double d = dx * dx + dy * dy;
+    double bx = x[result] - px, by = y[result] - py;
+    double bd = bx * bx + by * by;
+    return (d < bd || (d == bd && idx[j + tail] < idx[result])) ? j + tail : result;
+}
+
+__attribute__((target("sse2")))
+int nearestSquaredSse2(const double* x, const double* y, const double* idx, int m,
+                       double px, double py) {
+    __m128d vpx = _mm_set1_pd(px), vpy = _mm_set1_pd(py);
+    __m128d best = _mm_set1_pd(numeric_limits<double>::infinity()), bestIdx = _mm_setzero_pd();
+    __m128d bestSlot = _mm_set1_pd(-1), slot = _mm_setr_pd(0, 1), step = _mm_set1_pd(2);
+    int j = 0;
+    for (; j + 2 <= m; j += 2) {
+        __m128d dx = _mm_sub_pd(_mm_loadu_pd(x + j), vpx);
+        __m128d dy = _mm_sub_pd(_mm_loadu_pd(y + j), vpy);
+        __m128d d = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+        __m128d id = _mm_loadu_pd(idx + j);
+        __m128d better = _mm_or_pd(_mm_cmplt_pd(d, best),
+                                   _mm_and_pd(_mm_cmpeq_pd(d, best), _mm_cmplt_pd(id, bestIdx)));
+        best = _mm_or_pd(_mm_and_pd(better, d), _mm_andnot_pd(better, best));
+        bestIdx = _mm_or_pd(_mm_and_pd(better, id), _mm_andnot_pd(better, bestIdx));
+        bestSlot = _mm_or_pd(_mm_and_pd(better, slot), _mm_andnot_pd(better, bestSlot));
+        slot = _mm_add_pd(slot, step);
+    }
+    alignas(16) double value[2], ids[2], slots[2];
+    _mm_store_pd(value, best);
+    _mm_store_pd(ids, bestIdx);
+    _mm_store_pd(slots, bestSlot);
+    return mergeNearestTail(x, y, idx, m, j, px, py, value, ids, slots, 2);
+}
+
+__attribute__((target("avx2")))
+int nearestSquaredAvx2(const double* x, const double* y, const double* idx, int m,
+                       double px, double py) {
+    __m256d vpx = _mm256_set1_pd(px), vpy = _mm256_set1_pd(py);
+    __m256d best = _mm256_set1_pd(numeric_limits<double>::infinity()), bestIdx = _mm256_setzero_pd();
+    __m256d bestSlot = _mm256_set1_pd(-1), slot = _mm256_setr_pd(0, 1, 2, 3);
+    __m256d step = _mm256_set1_pd(4);
+    int j = 0;
+    for (; j + 4 <= m; j += 4) {
+        __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + j), vpx);
+        __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(y + j), vpy);
+        __m256d d = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+        __m256d id = _mm256_loadu_pd(idx + j);
+        __m256d better = _mm256_or_pd(
+            _mm256_cmp_pd(d, best, _CMP_LT_OQ),
+            _mm256_and_pd(_mm256_cmp_pd(d, best, _CMP_EQ_OQ), _mm256_cmp_pd(id, bestIdx, _CMP_LT_OQ)));
+        best = _mm256_blendv_pd(best, d, better);
+        bestIdx = _mm256_blendv_pd(bestIdx, id, better);
+        bestSlot = _mm256_blendv_pd(bestSlot, slot, better);
+        slot = _mm256_add_pd(slot, step);
+    }
+    alignas(32) double value[4], ids[4], slots[4];
+    _mm256_store_pd(value, best);
+    _mm256_store_pd(ids, bestIdx);
+    _mm256_store_pd(slots, bestSlot);
+    return mergeNearestTail(x, y, idx, m, j, px, py, value, ids, slots, 4);
+}
+
+__attribute__((target("avx512f")))
+int nearestSquaredAvx512(const double* x, const double* y, const double* idx, int m,
+                         double px, double py) {
+    __m512d vpx = _mm512_set1_pd(px), vpy = _mm512_set1_pd(py);
+    __m512d best = _mm512_set1_pd(numeric_limits<double>::infinity()), bestIdx = _mm512_setzero_pd();
+    __m512d bestSlot = _mm512_set1_pd(-1), slot = _mm512_setr_pd(0, 1, 2, 3, 4, 5, 6, 7);
+    __m512d step = _mm512_set1_pd(8);
+    int j = 0;
+    for (; j + 8 <= m; j += 8) {
+        __m512d dx = _mm512_sub_pd(_mm512_loadu_pd(x + j), vpx);
+        __m512d dy = _mm512_sub_pd(_mm512_loadu_pd(y + j), vpy);
+        __m512d d = _mm512_add_pd(_mm512_mul_pd(dx, dx), _mm512_mul_pd(dy, dy));
+        __m512d id = _mm512_loadu_pd(idx + j);
+        __mmask8 better = _mm512_cmp_pd_mask(d, best, _CMP_LT_OQ)
+                        | (_mm512_cmp_pd_mask(d, best, _CMP_EQ_OQ) & _mm512_cmp_pd_mask(id, bestIdx, _CMP_LT_OQ));
+        best = _mm512_mask_blend_pd(better, best, d);
+        bestIdx = _mm512_mask_blend_pd(better, bestIdx, id);
+        bestSlot = _mm512_mask_blend_pd(better, bestSlot, slot);
+        slot = _mm512_add_pd(slot, step);
+    }
+    alignas(64) double value[8], ids[8], slots[8];
+    _mm512_store_pd(value, best);
+    _mm512_store_pd(ids, bestIdx);
+    _mm512_store_pd(slots, bestSlot);
+    return mergeNearestTail(x, y, idx, m, j, px, py, value, ids, slots, 8);
+}
+
+#endif
+
+RelaxArgminKernel pickRelaxArgmin() {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return relaxArgminAvx512;
+    if (__builtin_cpu_supports("avx2")) return relaxArgminAvx2;
+    return relaxArgminSse2;
+#else
+    return relaxArgminScalar;
+#endif
+}
+
+NearestKernel pickNearestSquared() {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return nearestSquaredAvx512;
+    if (__builtin_cpu_supports("avx2")) return nearestSquaredAvx2;
+    return nearestSquaredSse2;
+#else
+    return nearestSquaredScalar;
+#endif
+}
+
+inline int relaxArgmin(const double* x, const double* y, double* key, double* from, int m,
+                       double px, double py, double source) {
+    static const RelaxArgminKernel kernel = pickRelaxArgmin();
+    return kernel(x, y, key, from, m, px, py, source);
+}
+
+inline int nearestSquared(const double* x, const double* y, const double* idx, int m,
+                          double px, double py) {
+    static const NearestKernel kernel = pickNearestSquared();
+    return kernel(x, y, idx, m, px, py);
+}
+
+// ============================================================================
+// HILBERT CURVE
+// ============================================================================
+
+const int kHilbertOrder = 20;
+
+// Position of cell (x, y) along the Hilbert curve over a 2^order grid
+uint64_t hilbertIndex(uint32_t x, uint32_t y, int order = kHilbertOrder) {
+    uint32_t side = 1u << order;
+    uint64_t d = 0;
+    for (uint32_t s = side / 2; s > 0; s /= 2) {
+        uint32_t rx = (x & s) > 0;
+        uint32_t ry = (y & s) > 0;
+        d += (uint64_t)s * s * ((3 * rx) ^ ry);
+        if (ry == 0) {
+            if (rx == 1) {
+                x = side - 1 - x;
+                y = side - 1 - y;
+            }
+            swap(x, y);
+        }
+    }
+    return d;
+}
+
+// Point indices sorted along the Hilbert curve through the bounding box
+// (equal cells keep input order). O(n log n); doubles as a quick tour.
+vector<int> hilbertOrder(const vector<Point>& points) {
+    int n = points.size();
+    vector<int> order(n);
+    for (int i = 0; i < n; i++) order[i] = i;
+    if (n == 0) return order;
+
+    double minX = points[0].x, maxX = minX, minY = points[0].y, maxY = minY;
+    for (const auto& p : points) {
+        minX = min(minX, p.x); maxX = max(maxX, p.x);
+        minY = min(minY, p.y); maxY = max(maxY, p.y);
+    }
+    double span = max(maxX - minX, maxY - minY);
+    double scale = span > 0 ? ((1u << kHilbertOrder) - 1) / span : 0.0;
+
+    vector<uint64_t> key(n);
+    for (int i = 0; i < n; i++) {
+        key[i] = hilbertIndex((uint32_t)((points[i].x - minX) * scale),
+                              (uint32_t)((points[i].y - minY) * scale));
+    }
+    stable_sort(order.begin(), order.end(), [&](int a, int b) { return key[a] < key[b]; });
+    return order;
+}
+
+// Lays the points out in Hilbert order so that cities close in the plane
+// are close in memory. Ids travel with the points, so tourIndicesToIds
+// still reports the input ids.
+void reorderAlongHilbert(vector<Point>& points) {
+    vector<Point> reordered;
+    reordered.reserve(points.size());
+    for (int i : hilbertOrder(points)) reordered.push_back(points[i]);
+    points.swap(reordered);
+}
+
+// ============================================================================
+// SPATIAL INDEX
+// ============================================================================
+
+// k-d tree over point indices. Points can be removed, nearest() then only
+// returns points that are still alive. Ties are broken by the smaller index,
+// so a query gives the same answer as a linear scan with a strict '<'.
+class KdTree {
+public:
+    explicit KdTree(const vector<Point>& points, int leafSize = 8)
+        : points(points), leafSize(leafSize), order(points.size()),
+          leafOf(points.size(), -1), removed(points.size(), 0) {
+        for (int i = 0; i < (int)points.size(); i++) order[i] = i;
+        nodes.reserve(2 * points.size() / leafSize + 1);
+        if (!points.empty()) build(0, points.size(), -1);
+    }
+
+    int aliveCount() const { return nodes.empty() ? 0 : nodes[0].alive; }
+    bool isAlive(int i) const { return !removed[i]; }
+
+    void remove(int i) {
+        if (removed[i]) return;
+        removed[i] = 1;
+        for (int node = leafOf[i]; node != -1; node = nodes[node].parent) {
+            nodes[node].alive--;
+        }
+    }
+
+    void restore(int i) {
+        if (!removed[i]) return;
+        removed[i] = 0;
+        for (int node = leafOf[i]; node != -1; node = nodes[node].parent) {
+            nodes[node].alive++;
+        }
+    }
+
+    void reset() {
+        fill(removed.begin(), removed.end(), 0);
+        for (auto& node : nodes) node.alive = node.end - node.begin;
+    }
+
+    // Nearest alive point to (x, y), -1 if every point was removed.
+    int nearest(double x, double y) const {
+        int best = -1;
+        double bestDist = numeric_limits<double>::max();
+        if (aliveCount() > 0) nearestRec(0, x, y, best, bestDist);
+        return best;
+    }
+
+    // k nearest points to point i (i itself excluded, removals ignored),
+    // sorted by increasing distance.
+    vector<int> kNearest(int i, int k) const {
+        vector<pair<double, int>> heap;
+        heap.reserve(k + 1);
+        if (k > 0 && !nodes.empty()) kNearestRec(0, i, k, heap);
+        sort_heap(heap.begin(), heap.end());
+        vector<int> result;
+        result.reserve(heap.size());
+        for (const auto& entry : heap) result.push_back(entry.second);
+        return result;
+    }
+
+private:
+    struct Node {
+        double minX, minY, maxX, maxY;
+        int begin, end;
+        int left, right;
+        int parent;
+        int alive;
+    };
+
+    const vector<Point>& points;
+    int leafSize;
+    vector<int> order;
+    vector<int> leafOf;
+    vector<char> removed;
+    vector<Node> nodes;
+
+    int build(int begin, int end, int parent) {
+        int id = nodes.size();
+        nodes.push_back({0, 0, 0, 0, begin, end, -1, -1, parent, end - begin});
+
+        double minX = numeric_limits<double>::max(), minY = minX;
+        double maxX = -minX, maxY = -minX;
+        for (int k = begin; k < end; k++) {
+            const Point& p = points[order[k]];
+            minX = min(minX, p.x); maxX = max(maxX, p.x);
+            minY = min(minY, p.y); maxY = max(maxY, p.y);
+        }
+        nodes[id].minX = minX; nodes[id].maxX = maxX;
+        nodes[id].minY = minY; nodes[id].maxY = maxY;
+
+        if (end - begin <= leafSize) {
+            for (int k = begin; k < end; k++) leafOf[order[k]] = id;
+            return id;
+        }
+
+        int mid = (begin + end) / 2;
+        if (maxX - minX >= maxY - minY) {
+            nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                        [&](int a, int b) { return points[a].x < points[b].x; });
+        } else {
+            nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                        [&](int a, int b) { return points[a].y < points[b].y; });
+        }
+        int left = build(begin, mid, id);
+        int right = build(mid, end, id);
+        nodes[id].left = left;
+        nodes[id].right = right;
+        return id;
+    }
+
+    // Squared distances throughout: only their order matters here.
+    double boxDistance(const Node& node, double x, double y) const {
+        double dx = max(0.0, max(node.minX - x, x - node.maxX));
+        double dy = max(0.0, max(node.minY - y, y - node.maxY));
+        return dx * dx + dy * dy;
+    }
+
+    void nearestRec(int id, double x, double y, int& best, double& bestDist) const {
+        const Node& node = nodes[id];
+        if (node.alive == 0 || boxDistance(node, x, y) > bestDist) return;
+
+        if (node.left < 0) {
+            for (int k = node.begin; k < node.end; k++) {
+                int j = order[k];
+                if (removed[j]) continue;
+                double dx = x - points[j].x;
+                double dy = y - points[j].y;
+                double d = dx * dx + dy * dy;
+                if (d < bestDist || (d == bestDist && j < best)) {
+                    bestDist = d;
+                    best = j;
+                }
+            }
+            return;
+        }
+
+        double dl = boxDistance(nodes[node.left], x, y);
+        double dr = boxDistance(nodes[node.right], x, y);
+        if (dl <= dr) {
+            nearestRec(node.left, x, y, best, bestDist);
+            nearestRec(node.right, x, y, best, bestDist);
+        } else {
+            nearestRec(node.right, x, y, best, bestDist);
+            nearestRec(node.left, x, y, best, bestDist);
+        }
+    }
+
+    void kNearestRec(int id, int i, int k, vector<pair<double, int>>& heap) const {
+        const Node& node = nodes[id];
+        const Point& q = points[i];
+        if ((int)heap.size() == k && boxDistance(node, q.x, q.y) > heap.front().first) return;
+
+        if (node.left < 0) {
+            for (int t = node.begin; t < node.end; t++) {
+                int j = order[t];
+                if (j == i) continue;
+                double dx = q.x - points[j].x;
+                double dy = q.y - points[j].y;
+                pair<double, int> entry(dx * dx + dy * dy, j);
+                if ((int)heap.size() < k) {
+                    heap.push_back(entry);
+                    push_heap(heap.begin(), heap.end());
+                } else if (entry < heap.front()) {
+                    pop_heap(heap.begin(), heap.end());
+                    heap.back() = entry;
+                    push_heap(heap.begin(), heap.end());
+                }
+            }
+            return;
+        }
+
+        double dl = boxDistance(nodes[node.left], q.x, q.y);
+        double dr = boxDistance(nodes[node.right], q.x, q.y);
+        if (dl <= dr) {
+            kNearestRec(node.left, i, k, heap);
+            kNearestRec(node.right, i, k, heap);
+        } else {
+            kNearestRec(node.right, i, k, heap);
+            kNearestRec(node.left, i, k, heap);
+        }
+    }
+};
+
+// Runs task(i) for every i in [0, count) on a pool of worker threads that
+// pull indices from a shared counter.
+template <class Task>
+void parallelFor(int count, int threads, const Task& task) {
+    threads = max(1, min(threads, count));
+    if (threads == 1) {
+        for (int i = 0; i < count; i++) task(i);
+        return;
+    }
+
+    atomic<int> nextIndex(0);
+    vector<thread> workers;
+    workers.reserve(threads);
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&]() {
+            for (int i = nextIndex++; i < count; i = nextIndex++) task(i);
+        });
+    }
+    for (auto& worker : workers) worker.join();
+}
+
+// Candidate lists: the k nearest neighbours of every city, nearest first.
+struct NeighborLists {
+    int k = 0;
+    vector<int> data;
+
+    const int* begin(int c) const { return data.data() + (size_t)c * k; }
+    const int* end(int c) const { return begin(c) + k; }
+};
+
+// Same interface, but a list is filled from the k-d tree the first time it
+// is read. For searches that only touch a few cities (incremental mode);
+// not const and not for sharing between threads.
+class LazyNeighborLists {
+public:
+    LazyNeighborLists(const KdTree& tree, int n, int k)
+        : k(max(0, min(k, n - 1))), data((size_t)n * this->k), tree(tree), ready(n, 0) {}
+
+    const int* begin(int c) {
+        if (!ready[c]) {
+            vector<int> nearest = tree.kNearest(c, k);
+            copy(nearest.begin(), nearest.end(), data.begin() + (size_t)c * k);
+            ready[c] = 1;
+        }
+        return data.data() + (size_t)c * k;
+    }
+    const int* end(int c) { return begin(c) + k; }
+
+private:
+    int k;
+    vector<int> data;
+    const KdTree& tree;
+    vector<char> ready;
+};
+
+NeighborLists buildNeighborLists(const vector<Point>& points, int k, int threads = 1) {
+    ScopedPhase phase("neighbor_lists");
+    int n = points.size();
+    NeighborLists lists;
+    lists.k = max(0, min(k, n - 1));
+    lists.data.resize((size_t)n * lists.k);
+
+    KdTree tree(points);
+    const int block = 1024;
+    parallelFor((n + block - 1) / block, threads, [&](int b) {
+        for (int i = b * block; i < min(n, (b + 1) * block); i++) {
+            vector<int> nearest = tree.kNearest(i, lists.k);
+            copy(nearest.begin(), nearest.end(), lists.data.begin() + (size_t)i * lists.k);
+        }
+    });
+    return lists;
+}
+
+// Tour stored as a city array plus the position of every city.
+// reverse() flips whichever side of the cycle is shorter.
+class ArrayTour {
+public:
+    explicit ArrayTour(const vector<int>& tour) : order(tour), pos(tour.size()) {
+        for (int i = 0; i < (int)order.size(); i++) pos[order[i]] = i;
+    }
+
+    int size() const { return order.size(); }
+    const vector<int>& cities() const { return order; }
+
+    int next(int c) const {
+        int p = pos[c] + 1;
+        return order[p == size() ? 0 : p];
+    }
+
+    int prev(int c) const {
+        int p = pos[c];
+        return order[p == 0 ? size() - 1 : p - 1];
+    }
+
+    // True if b lies on the forward path from a to c.
+    bool between(int a, int b, int c) const {
+        int pa = pos[a], pb = pos[b], pc = pos[c];
+        if (pa <= pc) return pa <= pb && pb <= pc;
+        return pb >= pa || pb <= pc;
+    }
+
+    // Reverse the forward path b..c. The complementary path is reversed
+    // instead when it is shorter, which describes the same cycle.
+    void reverse(int b, int c) {
+        int n = size();
+        int i = pos[b], j = pos[c];
+        int len = j - i;
+        if (len < 0) len += n;
+        len++;
+        if (2 * len > n) {
+            i = pos[c] + 1;
+            j = pos[b] - 1;
+            len = n - len;
+        }
+        for (int s = 0; s < len / 2; s++) {
+            if (i >= n) i -= n;
+            if (j < 0) j += n;
+            swap(order[i], order[j]);
+            pos[order[i]] = i;
+            pos[order[j]] = j;
+            i++;
+            j--;
+        }
+    }
+
+private:
+    vector<int> order;
+    vector<int> pos;
+};
+
+// Two-level doubly-linked list (Fredman et al.): the tour is cut into about
+// sqrt(n) segments, each with its own reversal bit. next/prev/between are
+// O(1) and reverse() is O(sqrt(n)): the path is split at its ends and then
+// only the order and reversal bits of whole segments change.
+class TwoLevelTour {
+public:
+    explicit TwoLevelTour(const vector<int>& tour)
+        : n(tour.size()), seg(tour.size()), idx(tour.size()) {
+        groupSize = max(8, (int)sqrt((double)n));
+        rebuild(tour);
+    }
+
+    int size() const { return n; }
+
+    int next(int c) const {
+        const Segment& s = segs[seg[c]];
+        int i = idx[c];
+        if (!s.reversed) {
+            if (i + 1 < (int)s.cities.size()) return s.cities[i + 1];
+        } else if (i > 0) {
+            return s.cities[i - 1];
+        }
+        return first(order[s.rank + 1 == (int)order.size() ? 0 : s.rank + 1]);
+    }
+
+    int prev(int c) const {
+        const Segment& s = segs[seg[c]];
+        int i = idx[c];
+        if (!s.reversed) {
+            if (i > 0) return s.cities[i - 1];
+        } else if (i + 1 < (int)s.cities.size()) {
+            return s.cities[i + 1];
+        }
+        return last(order[s.rank == 0 ? order.size() - 1 : s.rank - 1]);
+    }
+
+    bool between(int a, int b, int c) const {
+        long long ka = key(a), kb = key(b), kc = key(c);
+        if (ka <= kc) return ka <= kb && kb <= kc;
+        return kb >= ka || kb <= kc;
+    }
+
+    void reverse(int b, int c) {
+        if (b == c || next(c) == b) return;
+
+        int sb = seg[b];
+        if (sb == seg[c] && offset(b) <= offset(c)) {
+            Segment& s = segs[sb];
+            int i = idx[b], j = idx[c];
+            if (i > j) swap(i, j);
+            if (2 * (j - i + 1) <= n) {
+                std::reverse(s.cities.begin() + i, s.cities.begin() + j + 1);
+                for (int k = i; k <= j; k++) idx[s.cities[k]] = k;
+                return;
+            }
+        }
+
+        splitBefore(b);
+        splitBefore(next(c));
+
+        int m = order.size();
+        int rb = segs[seg[b]].rank, rc = segs[seg[c]].rank;
+        int len = rc - rb;
+        if (len < 0) len += m;
+        len++;
+        if (2 * len > m) {
+            reverseRanks(rc + 1 == m ? 0 : rc + 1, rb == 0 ? m - 1 : rb - 1, m - len);
+        } else {
+            reverseRanks(rb, rc, len);
+        }
+
+        if ((int)order.size() > 2 * (n / groupSize + 1)) rebuild(cities());
+    }
+
+    vector<int> cities() const {
+        vector<int> result;
+        result.reserve(n);
+        for (int s : order) {
+            const Segment& segment = segs[s];
+            if (segment.reversed) {
+                result.insert(result.end(), segment.cities.rbegin(), segment.cities.rend());
+            } else {
+                result.insert(result.end(), segment.cities.begin(), segment.cities.end());
+            }
+        }
+        return result;
+    }
+
+private:
+    struct Segment {
+        vector<int> cities;
+        bool reversed;
+        int rank;
+    };
+
+    int n;
+    int groupSize;
+    vector<Segment> segs;
+    vector<int> order;
+    vector<int> seg;
+    vector<int> idx;
+
+    int first(int s) const { return segs[s].reversed ? segs[s].cities.back() : segs[s].cities.front(); }
+    int last(int s) const { return segs[s].reversed ? segs[s].cities.front() : segs[s].cities.back(); }
+
+    int offset(int c) const {
+        const Segment& s = segs[seg[c]];
+        return s.reversed ? (int)s.cities.size() - 1 - idx[c] : idx[c];
+    }
+
+    long long key(int c) const {
+        return ((long long)segs[seg[c]].rank << 32) | offset(c);
+    }
+
+    void rebuild(const vector<int>& tour) {
+        segs.clear();
+        order.clear();
+        for (int start = 0; start < n; start += groupSize) {
+            int id = segs.size();
+            int end = min(n, start + groupSize);
+            segs.push_back({vector<int>(tour.begin() + start, tour.begin() + end), false, id});
+            order.push_back(id);
+            for (int k = start; k < end; k++) {
+                seg[tour[k]] = id;
+                idx[tour[k]] = k - start;
+            }
+        }
+    }
+
+    // Split the segment of c so that c becomes its first city.
+    void splitBefore(int c) {
+        int s = seg[c];
+        if (first(s) == c) return;
+
+        int id = segs.size();
+        int i = idx[c];
+        segs.push_back({{}, segs[s].reversed, 0});
+        Segment& src = segs[s];
+        Segment& dst = segs[id];
+
+        // Forward order is physical order, or its reverse when the bit is set.
+        // Either way the physical tail moves to the new segment.
+        int cut = src.reversed ? i + 1 : i;
+        dst.cities.assign(src.cities.begin() + cut, src.cities.end());
+        src.cities.resize(cut);
+        for (int k = 0; k < (int)dst.cities.size(); k++) {
+            seg[dst.cities[k]] = id;
+            idx[dst.cities[k]] = k;
+        }
+
+        int at = src.reversed ? src.rank : src.rank + 1;
+        order.insert(order.begin() + at, id);
+        for (int r = at; r < (int)order.size(); r++) segs[order[r]].rank = r;
+    }
+
+    // Reverse len consecutive segments of the cyclic order, ranks i..j.
+    void reverseRanks(int i, int j, int len) {
+        int m = order.size();
+        for (int k = 0; k < len; k++) {
+            int r = i + k;
+            if (r >= m) r -= m;
+            segs[order[r]].reversed = !segs[order[r]].reversed;
+        }
+        for (int k = 0; k < len / 2; k++) {
+            if (i >= m) i -= m;
+            if (j < 0) j += m;
+            swap(order[i], order[j]);
+            segs[order[i]].rank = i;
+            segs[order[j]].rank = j;
+            i++;
+            j--;
+        }
+    }
+};
+
+// Dense Prim on squared distances: the points outside the tree stay
+// compacted in a Coordinates prefix, so every step is one relaxArgmin scan.
+vector<pair<int, int>> buildMSTDense(const vector<Point>& points) {
+    int n = points.size();
+    vector<pair<int, int>> mst;
+    if (n == 0) return mst;
+    mst.reserve(n - 1);
+
+    Coordinates rest(points);
+    vector<double> key(n, numeric_limits<double>::infinity());
+    vector<double> from(n, -1);
+
+    int u = 0;
+    rest.remove(0);
+    while (rest.size() > 0) {
+        int slot = relaxArgmin(rest.x.data(), rest.y.data(), key.data(), from.data(), rest.size(),
+                               points[u].x, points[u].y, u);
+        u = rest.idx[slot];
+        mst.push_back({(int)from[slot], u});
+
+        int last = rest.size() - 1;
+        swap(key[slot], key[last]);
+        swap(from[slot], from[last]);
+        rest.remove(slot);
+    }
+    return mst;
+}
+
+// ============================================================================
+// DELAUNAY TRIANGULATION / MST
+// ============================================================================
+
+// Sweep-hull Delaunay triangulation (the Delaunator algorithm). Points are
+// inserted in order of distance from the circumcentre of a seed triangle,
+// the convex hull is a linked list with an angular hash for locating the
+// visible edge, and new triangles are legalised by edge flips.
+// triangles[3t..3t+2] are the vertices of triangle t, halfedges[e] is the
+// opposite half-edge of e or -1 on the hull. Exact duplicates are skipped;
+// if every point is collinear no triangles are produced.
+class Delaunay {
+public:
+    vector<int> triangles;
+    vector<int> halfedges;
+
+    explicit Delaunay(const vector<Point>& points) : points(points) {
+        ScopedPhase phase("delaunay");
+        int n = points.size();
+        if (n < 3) return;
+
+        double minX = numeric_limits<double>::max(), minY = minX;
+        double maxX = -minX, maxY = -minX;
+        for (const Point& p : points) {
+            minX = min(minX, p.x); maxX = max(maxX, p.x);
+            minY = min(minY, p.y); maxY = max(maxY, p.y);
+        }
+        double cx = (minX + maxX) / 2, cy = (minY + maxY) / 2;
+
+        int i0 = 0, i1 = -1, i2 = -1;
+        double minDist = numeric_limits<double>::max();
+        for (int i = 0; i < n; i++) {
+            double d = sqDist(cx, cy, points[i].x, points[i].y);
+            if (d < minDist) { i0 = i; minDist = d; }
+        }
+        minDist = numeric_limits<double>::max();
+        for (int i = 0; i < n; i++) {
+            if (i == i0) continue;
+            double d = sqDist(points[i0].x, points[i0].y, points[i].x, points[i].y);
+            if (d < minDist && d > 0) { i1 = i; minDist = d; }
+        }
+        if (i1 == -1) return;
+
+        double minRadius = numeric_limits<double>::max();
+        for (int i = 0; i < n; i++) {
+            if (i == i0 || i == i1) continue;
+            double r = circumradius(i0, i1, i);
+            if (r < minRadius) { i2 = i; minRadius = r; }
+        }
+        if (i2 == -1 || minRadius == numeric_limits<double>::max()) return;
+
+        if (orient(points[i0].x, points[i0].y, i1, i2)) swap(i1, i2);
+        circumcenter(i0, i1, i2, centerX, centerY);
+
+        vector<double> dists(n);
+        vector<int> ids(n);
+        for (int i = 0; i < n; i++) {
+            ids[i] = i;
+            dists[i] = sqDist(points[i].x, points[i].y, centerX, centerY);
+        }
+        sort(ids.begin(), ids.end(), [&](int a, int b) { return dists[a] < dists[b]; });
+
+        hashSize = (int)ceil(sqrt((double)n));
+        hullPrev.assign(n, 0);
+        hullNext.assign(n, 0);
+        hullTri.assign(n, 0);
+        hullHash.assign(hashSize, -1);
+
+        int maxTriangles = 2 * n - 5;
+        triangles.reserve(maxTriangles * 3);
+        halfedges.reserve(maxTriangles * 3);
+
+        hullStart = i0;
+        hullNext[i0] = hullPrev[i2] = i1;
+        hullNext[i1] = hullPrev[i0] = i2;
+        hullNext[i2] = hullPrev[i1] = i0;
+        hullTri[i0] = 0;
+        hullTri[i1] = 1;
+        hullTri[i2] = 2;
+        hullHash[hashKey(points[i0].x, points[i0].y)] = i0;
+        hullHash[hashKey(points[i1].x, points[i1].y)] = i1;
+        hullHash[hashKey(points[i2].x, points[i2].y)] = i2;
+        addTriangle(i0, i1, i2, -1, -1, -1);
+
+        double xp = numeric_limits<double>::quiet_NaN(), yp = xp;
+        for (int k = 0; k < n; k++) {
+            int i = ids[k];
+            double x = points[i].x, y = points[i].y;
+
+            if (x == xp && y == yp) continue;
+            xp = x;
+            yp = y;
+            if (i == i0 || i == i1 || i == i2) continue;
+
+            int start = 0;
+            int key = hashKey(x, y);
+            for (int j = 0; j < hashSize; j++) {
+                start = hullHash[(key + j) % hashSize];
+                if (start != -1 && start != hullNext[start]) break;
+            }
+            start = hullPrev[start];
+
+            int e = start;
+            int q;
+            while (q = hullNext[e], !orient(x, y, e, q)) {
+                e = q;
+                if (e == start) {
+                    e = -1;
+                    break;
+                }
+            }
+            if (e == -1) continue;
+
+            int t = addTriangle(e, i, hullNext[e], -1, -1, hullTri[e]);
+            hullTri[i] = legalize(t + 2);
+            hullTri[e] = t;
+
+            int next = hullNext[e];
+            while (q = hullNext[next], orient(x, y, next, q)) {
+                t = addTriangle(next, i, q, hullTri[i], -1, hullTri[next]);
+                hullTri[i] = legalize(t + 2);
+                hullNext[next] = next;
+                next = q;
+            }
+
+            if (e == start) {
+                while (q = hullPrev[e], orient(x, y, q, e)) {
+                    t = addTriangle(q, i, e, -1, hullTri[e], hullTri[q]);
+                    legalize(t + 2);
+                    hullTri[q] = t;
+                    hullNext[e] = e;
+                    e = q;
+                }
+            }
+
+            hullStart = hullPrev[i] = e;
+            hullNext[e] = hullPrev[next] = i;
+            hullNext[i] = next;
+
+            hullHash[hashKey(x, y)] = i;
+            hullHash[hashKey(points[e].x, points[e].y)] = e;
+        }
+    }
+
+    // Every triangulation edge once, as a pair of point indices.
+    vector<pair<int, int>> edges() const {
+        vector<pair<int, int>> result;
+        result.reserve(halfedges.size() / 2 + 1);
+        for (int e = 0; e < (int)halfedges.size(); e++) {
+            if (e > halfedges[e]) {
+                int next = e % 3 == 2 ? e - 2 : e + 1;
+                result.push_back({triangles[e], triangles[next]});
+            }
+        }
+        return result;
+    }
+
+private:
+    const vector<Point>& points;
+    double centerX = 0, centerY = 0;
+    int hashSize = 0;
+    int hullStart = 0;
+    vector<int> hullPrev, hullNext, hullTri, hullHash;
+    vector<int> edgeStack;
+
+    static double sqDist(double ax, double ay, double bx, double by) {
+        double dx = ax - bx, dy = ay - by;
+        return dx * dx + dy * dy;
+    }
+
+    // True if (px, py), q, r turn counter-clockwise.
+    bool orient(double px, double py, int q, int r) const {
+        double qx = points[q].x, qy = points[q].y;
+        double rx = points[r].x, ry = points[r].y;
+        return (qy - py) * (rx - qx) - (qx - px) * (ry - qy) < 0;
+    }
+
+    double circumradius(int a, int b, int c) const {
+        double x, y;
+        circumOffset(a, b, c, x, y);
+        return x * x + y * y;
+    }
+
+    void circumcenter(int a, int b, int c, double& x, double& y) const {
+        circumOffset(a, b, c, x, y);
+        x += points[a].x;
+        y += points[a].y;
+    }
+
+    void circumOffset(int a, int b, int c, double& x, double& y) const {
+        double dx = points[b].x - points[a].x, dy = points[b].y - points[a].y;
+        double ex = points[c].x - points[a].x, ey = points[c].y - points[a].y;
+        double bl = dx * dx + dy * dy;
+        double cl = ex * ex + ey * ey;
+        double det = dx * ey - dy * ex;
+        if (det == 0) {
+            x = y = numeric_limits<double>::max();
+            return;
+        }
+        double d = 0.5 / det;
+        x = (ey * bl - dy * cl) * d;
+        y = (dx * cl - ex * bl) * d;
+    }
+
+    bool inCircle(int a, int b, int c, int p) const {
+        double dx = points[a].x - points[p].x, dy = points[a].y - points[p].y;
+        double ex = points[b].x - points[p].x, ey = points[b].y - points[p].y;
+        double fx = points[c].x - points[p].x, fy = points[c].y - points[p].y;
+        double ap = dx * dx + dy * dy;
+        double bp = ex * ex + ey * ey;
+        double cp = fx * fx + fy * fy;
+        return dx * (ey * cp - bp * fy) - dy * (ex * cp - bp * fx) + ap * (ex * fy - ey * fx) < 0;
+    }
+
+    int hashKey(double x, double y) const {
+        double dx = x - centerX, dy = y - centerY;
+        double p = dx / (fabs(dx) + fabs(dy));
+        double angle = (dy > 0 ? 3 - p : 1 + p) / 4;
+        return (int)floor(angle * hashSize) % hashSize;
+    }
+
+    void link(int a, int b) {
+        halfedges[a] = b;
+        if (b != -1) halfedges[b] = a;
+    }
+
+    int addTriangle(int i0, int i1, int i2, int a, int b, int c) {
+        int t = triangles.size();
+        triangles.push_back(i0);
+        triangles.push_back(i1);
+        triangles.push_back(i2);
+        halfedges.push_back(-1);
+        halfedges.push_back(-1);
+        halfedges.push_back(-1);
+        link(t, a);
+        link(t + 1, b);
+        link(t + 2, c);
+        return t;
+    }
+
+    // Flip edge a and its neighbours until the Delaunay condition holds,
+    // with an explicit stack instead of recursion.
+    int legalize(int a) {
+        int ar = 0;
+        edgeStack.clear();
+        while (true) {
+            int b = halfedges[a];
+            int a0 = a - a % 3;
+            ar = a0 + (a + 2) % 3;
+
+            if (b == -1) {
+                if (edgeStack.empty()) break;
+                a = edgeStack.back();
+                edgeStack.pop_back();
+                continue;
+            }
+
+            int b0 = b - b % 3;
+            int al = a0 + (a + 1) % 3;
+            int bl = b0 + (b + 2) % 3;
+            int p0 = triangles[ar];
+            int pr = triangles[a];
+            int pl = triangles[al];
+            int p1 = triangles[bl];
+
+            if (inCircle(p0, pr, pl, p1)) {
+                triangles[a] = p1;
+                triangles[b] = p0;
+
+                int hbl = halfedges[bl];
+                if (hbl == -1) {
+                    int e = hullStart;
+                    do {
+                        if (hullTri[e] == bl) {
+                            hullTri[e] = a;
+                            break;
+                        }
+                        e = hullPrev[e];
+                    } while (e != hullStart);
+                }
+                link(a, hbl);
+                link(b, halfedges[ar]);
+                link(ar, bl);
+
+                int br = b0 + (b + 1) % 3;
+                edgeStack.push_back(br);
+            } else {
+                if (edgeStack.empty()) break;
+                a = edgeStack.back();
+                edgeStack.pop_back();
+            }
+        }
+        return ar;
+    }
+};
+
+struct DisjointSet {
+    vector<int> parent;
+    vector<int> rank;
+
+    explicit DisjointSet(int n) : parent(n), rank(n, 0) {
+        for (int i = 0; i < n; i++) parent[i] = i;
+    }
+
+    int find(int x) {
+        while (parent[x] != x) {
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    }
+
+    bool unite(int a, int b) {
+        a = find(a);
+        b = find(b);
+        if (a == b) return false;
+        if (rank[a] < rank[b]) swap(a, b);
+        parent[b] = a;
+        if (rank[a] == rank[b]) rank[a]++;
+        return true;
+    }
+};
+
+// Kruskal over the Delaunay edges: the Euclidean MST is a subgraph of the
+// triangulation, so this is exact in O(n log n). Points the triangulation
+// skipped (duplicates) are attached to their nearest triangulated point.
+// Falls back to dense Prim when all points are collinear.
+vector<pair<int, int>> buildMST(const vector<Point>& points) {
+    ScopedPhase phase("mst");
+    int n = points.size();
+    Delaunay dt(points);
+    if (dt.triangles.empty()) return buildMSTDense(points);
+
+    vector<pair<int, int>> edges = dt.edges();
+
+    vector<char> covered(n, 0);
+    for (int v : dt.triangles) covered[v] = 1;
+    if (count(covered.begin(), covered.end(), 0) > 0) {
+        KdTree tree(points);
+        for (int i = 0; i < n; i++) {
+            if (!covered[i]) tree.remove(i);
+        }
+        for (int i = 0; i < n; i++) {
+            if (!covered[i]) edges.push_back({i, tree.nearest(points[i].x, points[i].y)});
+        }
+    }
+
+    vector<double> length(edges.size());
+    vector<int> byLength(edges.size());
+    for (int e = 0; e < (int)edges.size(); e++) {
+        length[e] = distance(points[edges[e].first], points[edges[e].second]);
+        byLength[e] = e;
+    }
+    sort(byLength.begin(), byLength.end(), [&](int a, int b) { return length[a] < length[b]; });
+
+    vector<pair<int, int>> mst;
+    mst.reserve(n - 1);
+    DisjointSet dsu(n);
+    for (int e : byLength) {
+        if (dsu.unite(edges[e].first, edges[e].second)) {
+            mst.push_back(edges[e]);
+            if ((int)mst.size() == n - 1) break;
+        }
+    }
+
+    return mst;
+}
+
+vector<int> getOddDegreeVertices(int n, const vector<pair<int, int>>& edges) {
+    vector<int> degree(n, 0);
+    for (const auto& edge : edges) {
+        degree[edge.first]++;
+        degree[edge.second]++;
+    }
+
+    vector<int> odd;
+    for (int i = 0; i < n; i++) {
+        if (degree[i] % 2 == 1) {
+            odd.push_back(i);
+        }
+    }
+    return odd;
+}
+
+// Greedy matching on a sparse candidate graph: each odd vertex is linked to
+// its k nearest odd vertices (in either direction), the O(k * |odd|)
+// pairs are sorted once and taken greedily. Vertices still unmatched afterwards are paired by
+// nearest-unmatched queries on a k-d tree.
+vector<pair<int, int>> improvedMatching(const vector<Point>& points, const vector<int>& oddVertices, int k = 10) {
+    ScopedPhase phase("greedy_matching");
+    int m = oddVertices.size();
+    vector<Point> oddPoints;
+    oddPoints.reserve(m);
+    for (int v : oddVertices) oddPoints.push_back(points[v]);
+
+    KdTree tree(oddPoints);
+    vector<pair<double, pair<int, int>>> edges;
+    edges.reserve((size_t)m * k);
+    for (int i = 0; i < m; i++) {
+        for (int j : tree.kNearest(i, k)) {
+            edges.push_back({distance(oddPoints[i], oddPoints[j]), {min(i, j), max(i, j)}});
+        }
+    }
+    countEvent(kDistanceEvaluations, edges.size());
+    sort(edges.begin(), edges.end());
+    edges.erase(unique(edges.begin(), edges.end()), edges.end());
+
+    vector<pair<int, int>> matching;
+    matching.reserve(m / 2);
+    vector<bool> matched(m, false);
+
+    for (const auto& edge : edges) {
+        int i = edge.second.first;
+        int j = edge.second.second;
+
+        if (!matched[i] && !matched[j]) {
+            matching.push_back({oddVertices[i], oddVertices[j]});
+            matched[i] = true;
+            matched[j] = true;
+        }
+    }
+
+    for (int i = 0; i < m; i++) {
+        if (matched[i]) tree.remove(i);
+    }
+    for (int i = 0; i < m; i++) {
+        if (matched[i]) continue;
+        tree.remove(i);
+        int j = tree.nearest(oddPoints[i].x, oddPoints[i].y);
+        if (j == -1) break;
+        tree.remove(j);
+        matching.push_back({oddVertices[i], oddVertices[j]});
+        matched[i] = true;
+        matched[j] = true;
+    }
+
+    return matching;
+}
+
+// Maximum-weight matching in a general graph: Edmonds' blossom algorithm
+// with dual variables, after Van Rantwijk's mwmatching. Weights are
+// integers, so all duals stay integral (they are stored multiplied by two).
+// With maxCardinality the result is the heaviest matching among those of
+// maximum cardinality. perfectExists promises that the graph has a perfect
+// matching; then vertex duals need not stay non-negative, which justifies
+// the greedy jump start and lets each stage grow a single alternating tree
+// from one free vertex until it reaches another. A stage resets only the
+// vertices, blossoms and edges it touched, so its cost follows the size of
+// its tree rather than n + m.
+class BlossomMatching {
+public:
+    struct Edge {
+        int u, v;
+        long long w;
+    };
+
+    BlossomMatching(int n, const vector<Edge>& edges, bool maxCardinality, bool perfectExists = false)
+        : n(n), edges(edges), maxCardinality(maxCardinality), perfectExists(perfectExists) {}
+
+    // mate[v] is the vertex matched to v, or -1.
+    vector<int> solve() {
+        init();
+        bool singleTree = maxCardinality && perfectExists;
+        if (singleTree) jumpStart();
+
+        vector<int> freeVertices;
+        for (int v = 0; v < n; v++) {
+            if (mate[v] == -1) freeVertices.push_back(v);
+        }
+        size_t nextRoot = 0;
+
+        for (int stage = 0; stage < n; stage++) {
+            for (int v : touchedVertices) {
+                setLabel(v, 0);
+                bestEdge[v] = -1;
+            }
+            for (int b : touchedBlossoms) {
+                setLabel(b, 0);
+                bestEdge[b] = -1;
+                blossomBestEdges[b].clear();
+                hasBestEdges[b] = 0;
+            }
+            for (int k : allowedEdges) allowEdge[k] = 0;
+            for (int t : parkedTokens) parked[t].clear();
+            parkedTokens.clear();
+            queue.clear();
+            touchedVertices.clear();
+            touchedBlossoms.clear();
+            allowedEdges.clear();
+            vertexSlacks = {};
+            blossomSlacks = {};
+            blossomDuals = {};
+            stamp++;
+
+            // Matched vertices never become free again
+            while (nextRoot < freeVertices.size() && mate[freeVertices[nextRoot]] != -1) nextRoot++;
+            if (nextRoot == freeVertices.size()) break;
+            if (singleTree) {
+                assignLabel(freeVertices[nextRoot], 1, -1);
+            } else {
+                for (size_t i = nextRoot; i < freeVertices.size(); i++) {
+                    int v = freeVertices[i];
+                    if (mate[v] == -1 && label[top(v)] == 0) assignLabel(v, 1, -1);
+                }
+            }
+
+            bool augmented = false;
+            while (true) {
+                while (!queue.empty() && !augmented) {
+                    int v = queue.back();
+                    queue.pop_back();
+
+                    for (int p : neighbEnd[v]) {
+                        int k = p / 2;
+                        int w = endpoint[p];
+                        if (top(v) == top(w)) continue;
+
+                        long long kslack = 0;
+                        if (!allowEdge[k]) {
+                            kslack = slack(k);
+                            if (kslack <= 0) allow(k);
+                        }
+
+                        if (allowEdge[k]) {
+                            if (label[top(w)] == 0 && mate[w] == -1) {
+                                // Another tree's root, only outside the
+                                // forest when a single tree is grown
+                                assignLabel(w, 1, -1);
+                                augmentMatching(k);
+                                augmented = true;
+                                break;
+                            } else if (label[top(w)] == 0) {
+                                assignLabel(w, 2, p ^ 1);
+                            } else if (label[top(w)] == 1) {
+                                int base = scanBlossom(v, w);
+                                if (base >= 0) {
+                                    addBlossom(base, k);
+                                } else {
+                                    augmentMatching(k);
+                                    augmented = true;
+                                    break;
+                                }
+                            } else if (label[w] == 0) {
+                                label[w] = 2;
+                                labelEnd[w] = p ^ 1;
+                                touchVertex(w);
+                            }
+                        } else if (label[top(w)] == 1) {
+                            int b = top(v);
+                            if (bestEdge[b] == -1 || kslack < slack(bestEdge[b])) {
+                                bestEdge[b] = k;
+                                blossomSlacks.push({kslack + 2 * shift, b});
+                            }
+                        } else if (label[w] == 0) {
+                            if (bestEdge[w] == -1 || kslack < slack(bestEdge[w])) {
+                                bestEdge[w] = k;
+                                touchVertex(w);
+                                vertexSlacks.push({kslack + shift, w});
+                            }
+                        }
+                    }
+                }
+
+                if (augmented) break;
+
+                int deltaType = -1;
+                long long delta = 0;
+                int deltaEdge = -1, deltaBlossom = -1;
+
+                if (!maxCardinality) {
+                    deltaType = 1;
+                    delta = vertexDual(0);
+                    for (int v = 1; v < n; v++) delta = min(delta, vertexDual(v));
+                }
+
+                // Slacks and duals move by the same multiple of shift for
+                // every entry of a heap, so keys stay valid; entries whose
+                // owner changed are dropped or re-keyed when they surface
+                while (!vertexSlacks.empty()) {
+                    auto [key, v] = vertexSlacks.top();
+                    if (label[top(v)] != 0 || bestEdge[v] == -1) {
+                        vertexSlacks.pop();
+                        park(v);
+                        continue;
+                    }
+                    long long current = slack(bestEdge[v]) + shift;
+                    if (current != key) {
+                        vertexSlacks.pop();
+                        vertexSlacks.push({current, v});
+                        continue;
+                    }
+                    if (deltaType == -1 || key - shift < delta) {
+                        delta = key - shift;
+                        deltaType = 2;
+                        deltaEdge = bestEdge[v];
+                    }
+                    break;
+                }
+
+                while (!blossomSlacks.empty()) {
+                    auto [key, b] = blossomSlacks.top();
+                    if (blossomParent[b] != -1 || label[b] != 1 || bestEdge[b] == -1) {
+                        blossomSlacks.pop();
+                        continue;
+                    }
+                    long long current = slack(bestEdge[b]) + 2 * shift;
+                    if (current != key) {
+                        blossomSlacks.pop();
+                        blossomSlacks.push({current, b});
+                        continue;
+                    }
+                    long long d = (key - 2 * shift) / 2;
+                    if (deltaType == -1 || d < delta) {
+                        delta = d;
+                        deltaType = 3;
+                        deltaEdge = bestEdge[b];
+                    }
+                    break;
+                }
+
+                while (!blossomDuals.empty()) {
+                    auto [key, b] = blossomDuals.top();
+                    if (blossomBase[b] < 0 || blossomParent[b] != -1 || label[b] != 2) {
+                        blossomDuals.pop();
+                        continue;
+                    }
+                    long long current = blossomDual(b) + shift;
+                    if (current != key) {
+                        blossomDuals.pop();
+                        blossomDuals.push({current, b});
+                        continue;
+                    }
+                    if (deltaType == -1 || key - shift < delta) {
+                        delta = key - shift;
+                        deltaType = 4;
+                        deltaBlossom = b;
+                    }
+                    break;
+                }
+
+                if (deltaType == -1) {
+                    deltaType = 1;
+                    delta = vertexDual(0);
+                    for (int v = 1; v < n; v++) delta = min(delta, vertexDual(v));
+                    delta = max(0LL, delta);
+                }
+
+                shift += delta;
+
+                if (deltaType == 1) {
+                    break;
+                } else if (deltaType == 2) {
+                    allow(deltaEdge);
+                    int i = edges[deltaEdge].u, j = edges[deltaEdge].v;
+                    if (label[top(i)] == 0) swap(i, j);
+                    queue.push_back(i);
+                } else if (deltaType == 3) {
+                    allow(deltaEdge);
+                    queue.push_back(edges[deltaEdge].u);
+                } else {
+                    expandBlossom(deltaBlossom, false);
+                }
+            }
+
+            if (!augmented) break;
+
+            // S-blossoms were all labelled, hence touched, in this stage
+            for (int i = 0; i < (int)touchedBlossoms.size(); i++) {
+                int b = touchedBlossoms[i];
+                if (b >= n && blossomParent[b] == -1 && blossomBase[b] >= 0 && label[b] == 1 &&
+                    blossomDual(b) == 0) {
+                    expandBlossom(b, true);
+                }
+            }
+        }
+
+        vector<int> result(n, -1);
+        for (int v = 0; v < n; v++) {
+            if (mate[v] >= 0) result[v] = endpoint[mate[v]];
+        }
+        return result;
+    }
+
+private:
+    int n;
+    const vector<Edge>& edges;
+    bool maxCardinality;
+    bool perfectExists;
+
+    vector<int> endpoint;
+    vector<vector<int>> neighbEnd;
+    vector<int> mate;
+    vector<int> label;
+    vector<int> labelEnd;
+    vector<int> token;        // per vertex; tokenTop[token[v]] is its top-level blossom
+    vector<int> tokenTop;
+    vector<int> blossomToken;
+    vector<int> blossomSize;
+    vector<int> blossomParent;
+    vector<vector<int>> blossomChilds;
+    vector<int> blossomBase;
+    vector<vector<int>> blossomEndps;
+    vector<int> bestEdge;
+    vector<vector<int>> blossomBestEdges;
+    vector<char> hasBestEdges;
+    vector<int> unusedBlossoms;
+    vector<long long> dualVar;
+    vector<char> allowEdge;
+    vector<int> queue;
+    vector<int> bestEdgeTo;
+    vector<int> touchedVertices;
+    vector<int> touchedBlossoms;
+    vector<int> allowedEdges;
+    using MinHeap = priority_queue<pair<long long, int>, vector<pair<long long, int>>,
+                                   greater<pair<long long, int>>>;
+    MinHeap vertexSlacks;   // slack of bestEdge[v] + shift, v unlabelled
+    MinHeap blossomSlacks;  // slack of bestEdge[b] + 2 * shift, b an S-blossom
+    MinHeap blossomDuals;   // dual of b + shift, b a T-blossom
+    long long shift = 0;    // total delta so far
+    vector<long long> dualOffset;
+    vector<long long> dualShift;
+    vector<vector<int>> parked;
+    vector<int> parkedTokens;
+    vector<int> vertexStamp;
+    vector<int> blossomStamp;
+    vector<int> leafScratch;
+    int stamp = 0;
+
+    void init() {
+        int m = edges.size();
+        long long maxWeight = 0;
+        for (const Edge& e : edges) maxWeight = max(maxWeight, e.w);
+
+        endpoint.resize(2 * m);
+        neighbEnd.assign(n, {});
+        for (int k = 0; k < m; k++) {
+            endpoint[2 * k] = edges[k].u;
+            endpoint[2 * k + 1] = edges[k].v;
+            neighbEnd[edges[k].u].push_back(2 * k + 1);
+            neighbEnd[edges[k].v].push_back(2 * k);
+        }
+
+        mate.assign(n, -1);
+        label.assign(2 * n, 0);
+        labelEnd.assign(2 * n, -1);
+        token.resize(n);
+        tokenTop.resize(n);
+        blossomToken.assign(2 * n, -1);
+        blossomSize.assign(2 * n, 1);
+        for (int v = 0; v < n; v++) token[v] = tokenTop[v] = blossomToken[v] = v;
+        blossomParent.assign(2 * n, -1);
+        blossomChilds.assign(2 * n, {});
+        blossomBase.assign(2 * n, -1);
+        for (int v = 0; v < n; v++) blossomBase[v] = v;
+        blossomEndps.assign(2 * n, {});
+        bestEdge.assign(2 * n, -1);
+        blossomBestEdges.assign(2 * n, {});
+        hasBestEdges.assign(2 * n, 0);
+        unusedBlossoms.clear();
+        for (int b = 2 * n - 1; b >= n; b--) unusedBlossoms.push_back(b);
+        dualVar.assign(2 * n, 0);
+        fill(dualVar.begin(), dualVar.begin() + n, maxWeight);
+        allowEdge.assign(m, 0);
+        shift = 0;
+        dualOffset.assign(2 * n, 0);
+        dualShift.assign(2 * n, 0);
+        parked.assign(n, {});
+        parkedTokens.clear();
+        bestEdgeTo.assign(2 * n, -1);
+        vertexStamp.assign(n, 0);
+        blossomStamp.assign(2 * n, 0);
+    }
+
+    void touchVertex(int v) {
+        if (vertexStamp[v] != stamp) {
+            vertexStamp[v] = stamp;
+            touchedVertices.push_back(v);
+        }
+    }
+
+    void touchBlossom(int b) {
+        if (blossomStamp[b] != stamp) {
+            blossomStamp[b] = stamp;
+            touchedBlossoms.push_back(b);
+        }
+    }
+
+    int top(int v) const { return tokenTop[token[v]]; }
+
+    bool isTop(int b) const {
+        return b < n ? top(b) == b : blossomParent[b] == -1 && blossomBase[b] >= 0;
+    }
+
+    // How a vertex dual moves with shift under a top-level blossom labelled t
+    static int direction(int t) { return t == 2 ? 1 : t == 1 || t == 5 ? -1 : 0; }
+
+    // Duals are kept lazily. A vertex dual is dualVar[v] plus the offset of
+    // its top-level blossom plus shift in the blossom's direction, so
+    // relabelling a blossom only moves its offset. A blossom dual holds its
+    // value at dualShift[b] and is settled before its label changes.
+    long long vertexDual(int v) const {
+        int b = top(v);
+        return dualVar[v] + dualOffset[b] + direction(label[b]) * shift;
+    }
+
+    long long blossomDual(int b) const {
+        if (blossomParent[b] != -1) return dualVar[b];
+        long long moved = shift - dualShift[b];
+        return label[b] == 1 ? dualVar[b] + moved : label[b] == 2 ? dualVar[b] - moved : dualVar[b];
+    }
+
+    void settleBlossom(int b) {
+        if (b < n) return;
+        dualVar[b] = blossomDual(b);
+        dualShift[b] = shift;
+    }
+
+    void setLabel(int b, int t) {
+        if (isTop(b)) {
+            settleBlossom(b);
+            dualOffset[b] += (direction(label[b]) - direction(t)) * shift;
+        }
+        label[b] = t;
+    }
+
+    // Moves leaf v from top-level blossom from to top-level blossom to
+    void moveLeaf(int v, int from, int to) {
+        dualVar[v] += dualOffset[from] + direction(label[from]) * shift -
+                      dualOffset[to] - direction(label[to]) * shift;
+        token[v] = blossomToken[to];
+    }
+
+    // A vertex with a best edge inside a labelled blossom waits under its
+    // token until the blossom is expanded and may leave it unlabelled
+    void park(int v) {
+        if (bestEdge[v] == -1) return;
+        if (label[top(v)] == 0) {
+            vertexSlacks.push({slack(bestEdge[v]) + shift, v});
+            return;
+        }
+        if (parked[token[v]].empty()) parkedTokens.push_back(token[v]);
+        parked[token[v]].push_back(v);
+    }
+
+    void allow(int k) {
+        if (!allowEdge[k]) {
+            allowEdge[k] = 1;
+            allowedEdges.push_back(k);
+        }
+    }
+
+    // Greedy start, only valid for a graph with a perfect matching: each
+    // vertex dual is lowered to the smallest value that keeps its edges
+    // feasible and a tight edge to a free vertex is matched at once. All
+    // duals stay even, so slacks between S-vertices remain even as the
+    // stages require.
+    void jumpStart() {
+        for (int v = 0; v < n; v++) {
+            long long top = 0;
+            for (int p : neighbEnd[v]) top = max(top, edges[p / 2].w);
+            dualVar[v] = top + (top & 1);
+        }
+        for (int v = 0; v < n; v++) {
+            if (mate[v] != -1 || neighbEnd[v].empty()) continue;
+            int bestP = -1;
+            long long need = 0;
+            for (int p : neighbEnd[v]) {
+                int j = endpoint[p];
+                long long r = 2 * edges[p / 2].w - dualVar[j];
+                if (bestP == -1 || r > need ||
+                    (r == need && mate[j] == -1 && mate[endpoint[bestP]] != -1)) {
+                    need = r;
+                    bestP = p;
+                }
+            }
+            dualVar[v] = need;
+            int j = endpoint[bestP];
+            if (mate[j] == -1) {
+                mate[v] = bestP;
+                mate[j] = bestP ^ 1;
+            }
+        }
+    }
+
+    long long slack(int k) const {
+        return vertexDual(edges[k].u) + vertexDual(edges[k].v) - 2 * edges[k].w;
+    }
+
+    void blossomLeaves(int b, vector<int>& out) const {
+        if (b < n) {
+            out.push_back(b);
+            return;
+        }
+        for (int t : blossomChilds[b]) blossomLeaves(t, out);
+    }
+
+    void assignLabel(int w, int t, int p) {
+        while (true) {
+            int b = top(w);
+            setLabel(w, t);
+            setLabel(b, t);
+            labelEnd[w] = labelEnd[b] = p;
+            bestEdge[w] = bestEdge[b] = -1;
+            touchVertex(w);
+            touchBlossom(b);
+            if (t == 1) {
+                leafScratch.clear();
+                blossomLeaves(b, leafScratch);
+                queue.insert(queue.end(), leafScratch.begin(), leafScratch.end());
+                return;
+            }
+            if (b >= n) blossomDuals.push({dualVar[b] + shift, b});
+            int base = blossomBase[b];
+            w = endpoint[mate[base]];
+            t = 1;
+            p = mate[base] ^ 1;
+        }
+    }
+
+    int scanBlossom(int v, int w) {
+        vector<int> path;
+        int base = -1;
+        while (v != -1 || w != -1) {
+            int b = top(v);
+            if (label[b] & 4) {
+                base = blossomBase[b];
+                break;
+            }
+            path.push_back(b);
+            label[b] = 5;
+            if (labelEnd[b] == -1) {
+                v = -1;
+            } else {
+                v = endpoint[labelEnd[b]];
+                b = top(v);
+                v = endpoint[labelEnd[b]];
+            }
+            if (w != -1) swap(v, w);
+        }
+        for (int b : path) label[b] = 1;
+        return base;
+    }
+
+    void addBlossom(int base, int k) {
+        int v = edges[k].u, w = edges[k].v;
+        int bb = top(base);
+        int bv = top(v);
+        int bw = top(w);
+
+        int b = unusedBlossoms.back();
+        unusedBlossoms.pop_back();
+        blossomBase[b] = base;
+        blossomParent[b] = -1;
+        settleBlossom(bb);
+        blossomParent[bb] = b;
+
+        vector<int>& path = blossomChilds[b];
+        vector<int>& endps = blossomEndps[b];
+        path.clear();
+        endps.clear();
+
+        while (bv != bb) {
+            settleBlossom(bv);
+            blossomParent[bv] = b;
+            path.push_back(bv);
+            endps.push_back(labelEnd[bv]);
+            v = endpoint[labelEnd[bv]];
+            bv = top(v);
+        }
+        path.push_back(bb);
+        std::reverse(path.begin(), path.end());
+        std::reverse(endps.begin(), endps.end());
+        endps.push_back(2 * k);
+
+        while (bw != bb) {
+            settleBlossom(bw);
+            blossomParent[bw] = b;
+            path.push_back(bw);
+            endps.push_back(labelEnd[bw] ^ 1);
+            w = endpoint[labelEnd[bw]];
+            bw = top(w);
+        }
+
+        label[b] = 1;
+        labelEnd[b] = labelEnd[bb];
+        dualVar[b] = 0;
+        dualShift[b] = shift;
+        touchBlossom(b);
+
+        // b takes over the token of its largest sub-blossom, so only the
+        // leaves of the others move; T-vertices become S and get scanned
+        int largest = path[0];
+        blossomSize[b] = 0;
+        for (int sub : path) {
+            blossomSize[b] += blossomSize[sub];
+            if (blossomSize[sub] > blossomSize[largest]) largest = sub;
+        }
+        blossomToken[b] = blossomToken[largest];
+        dualOffset[b] = dualOffset[largest] + (direction(label[largest]) - direction(1)) * shift;
+        vector<int> leaves;
+        for (int sub : path) {
+            if (sub == largest && label[sub] != 2) continue;
+            leaves.clear();
+            blossomLeaves(sub, leaves);
+            for (int leaf : leaves) {
+                if (label[sub] == 2) queue.push_back(leaf);
+                if (sub != largest) moveLeaf(leaf, sub, b);
+            }
+        }
+        tokenTop[blossomToken[b]] = b;
+
+        vector<int> touched;
+        auto consider = [&](int edge) {
+            int i = edges[edge].u, j = edges[edge].v;
+            if (top(j) == b) swap(i, j);
+            int bj = top(j);
+            if (bj != b && label[bj] == 1 &&
+                (bestEdgeTo[bj] == -1 || slack(edge) < slack(bestEdgeTo[bj]))) {
+                if (bestEdgeTo[bj] == -1) touched.push_back(bj);
+                bestEdgeTo[bj] = edge;
+            }
+        };
+        for (int sub : path) {
+            if (!hasBestEdges[sub]) {
+                leaves.clear();
+                blossomLeaves(sub, leaves);
+                for (int leaf : leaves) {
+                    for (int p : neighbEnd[leaf]) consider(p / 2);
+                }
+            } else {
+                for (int edge : blossomBestEdges[sub]) consider(edge);
+            }
+            blossomBestEdges[sub].clear();
+            hasBestEdges[sub] = 0;
+            bestEdge[sub] = -1;
+        }
+
+        blossomBestEdges[b].clear();
+        for (int bj : touched) {
+            blossomBestEdges[b].push_back(bestEdgeTo[bj]);
+            bestEdgeTo[bj] = -1;
+        }
+        hasBestEdges[b] = 1;
+
+        bestEdge[b] = -1;
+        for (int edge : blossomBestEdges[b]) {
+            if (bestEdge[b] == -1 || slack(edge) < slack(bestEdge[b])) bestEdge[b] = edge;
+        }
+        if (bestEdge[b] != -1) blossomSlacks.push({slack(bestEdge[b]) + 2 * shift, b});
+    }
+
+    void expandBlossom(int b, bool endStage) {
+        // The child holding b's token gets it back; the leaves of the
+        // others move to their own tokens
+        vector<int> moved, leaves;
+        int heir = -1;
+        for (int s : blossomChilds[b]) {
+            settleBlossom(s);
+            blossomParent[s] = -1;
+            if (blossomToken[s] == blossomToken[b]) {
+                heir = s;
+                dualOffset[s] = dualOffset[b] + (direction(label[b]) - direction(label[s])) * shift;
+            } else {
+                dualOffset[s] = 0;
+                leaves.clear();
+                blossomLeaves(s, leaves);
+                for (int v : leaves) moveLeaf(v, b, s);
+                moved.insert(moved.end(), leaves.begin(), leaves.end());
+            }
+            tokenTop[blossomToken[s]] = s;
+        }
+        if (endStage) {
+            for (int s : blossomChilds[b]) {
+                if (s >= n && dualVar[s] == 0) expandBlossom(s, endStage);
+            }
+        }
+
+        if (!endStage && label[b] == 2) {
+            const vector<int>& childs = blossomChilds[b];
+            const vector<int>& endps = blossomEndps[b];
+            int size = childs.size();
+            int entryChild = top(endpoint[labelEnd[b] ^ 1]);
+            int j = find(childs.begin(), childs.end(), entryChild) - childs.begin();
+            int jstep, endpTrick;
+            if (j & 1) {
+                j -= size;
+                jstep = 1;
+                endpTrick = 0;
+            } else {
+                jstep = -1;
+                endpTrick = 1;
+            }
+            auto at = [size](const vector<int>& list, int i) { return list[i < 0 ? i + size : i]; };
+
+            int p = labelEnd[b];
+            while (j != 0) {
+                setLabel(endpoint[p ^ 1], 0);
+                setLabel(endpoint[at(endps, j - endpTrick) ^ endpTrick ^ 1], 0);
+                assignLabel(endpoint[p ^ 1], 2, p);
+                allow(at(endps, j - endpTrick) / 2);
+                j += jstep;
+                p = at(endps, j - endpTrick) ^ endpTrick;
+                allow(p / 2);
+                j += jstep;
+            }
+
+            int bv = at(childs, j);
+            setLabel(endpoint[p ^ 1], 2);
+            setLabel(bv, 2);
+            labelEnd[endpoint[p ^ 1]] = labelEnd[bv] = p;
+            bestEdge[bv] = -1;
+            touchVertex(endpoint[p ^ 1]);
+            touchBlossom(bv);
+            if (bv >= n) blossomDuals.push({dualVar[bv] + shift, bv});
+
+            j += jstep;
+            while (at(childs, j) != entryChild) {
+                bv = at(childs, j);
+                if (label[bv] == 1) {
+                    j += jstep;
+                    continue;
+                }
+                leaves.clear();
+                blossomLeaves(bv, leaves);
+                int reached = -1;
+                for (int v : leaves) {
+                    if (label[v] != 0) {
+                        reached = v;
+                        break;
+                    }
+                }
+                if (reached != -1) {
+                    setLabel(reached, 0);
+                    setLabel(endpoint[mate[blossomBase[bv]]], 0);
+                    assignLabel(reached, 2, labelEnd[reached]);
+                }
+                j += jstep;
+            }
+
+            // Vertices that left b keep their best edges, and so may the
+            // ones parked under b's token if its heir ended up unlabelled
+            for (int v : moved) park(v);
+            if (label[heir] == 0) {
+                vector<int> waiting;
+                waiting.swap(parked[blossomToken[heir]]);
+                for (int v : waiting) park(v);
+            }
+        }
+
+        label[b] = labelEnd[b] = -1;
+        touchBlossom(b);
+        blossomChilds[b].clear();
+        blossomEndps[b].clear();
+        blossomBase[b] = -1;
+        blossomBestEdges[b].clear();
+        hasBestEdges[b] = 0;
+        bestEdge[b] = -1;
+        unusedBlossoms.push_back(b);
+    }
+
+    void augmentBlossom(int b, int v) {
+        // The blossoms between v and b, innermost first, found in one climb
+        vector<int> path;
+        for (int t = v; t != b; t = blossomParent[t]) path.push_back(t);
+        augmentBlossom(b, path);
+    }
+
+    void augmentBlossom(int b, vector<int>& path) {
+        int t = path.back();
+        path.pop_back();
+        if (t >= n) augmentBlossom(t, path);
+
+        vector<int>& childs = blossomChilds[b];
+        vector<int>& endps = blossomEndps[b];
+        int size = childs.size();
+        int i = find(childs.begin(), childs.end(), t) - childs.begin();
+        int j = i;
+        int jstep, endpTrick;
+        if (i & 1) {
+            j -= size;
+            jstep = 1;
+            endpTrick = 0;
+        } else {
+            jstep = -1;
+            endpTrick = 1;
+        }
+        auto at = [size](const vector<int>& list, int k) { return list[k < 0 ? k + size : k]; };
+
+        while (j != 0) {
+            j += jstep;
+            t = at(childs, j);
+            int p = at(endps, j - endpTrick) ^ endpTrick;
+            if (t >= n) augmentBlossom(t, endpoint[p]);
+            j += jstep;
+            t = at(childs, j);
+            if (t >= n) augmentBlossom(t, endpoint[p ^ 1]);
+            mate[endpoint[p]] = p ^ 1;
+            mate[endpoint[p ^ 1]] = p;
+        }
+
+        rotate(childs.begin(), childs.begin() + i, childs.end());
+        rotate(endps.begin(), endps.begin() + i, endps.end());
+        blossomBase[b] = blossomBase[childs[0]];
+    }
+
+    void augmentMatching(int k) {
+        int ends[2][2] = {{edges[k].u, 2 * k + 1}, {edges[k].v, 2 * k}};
+        for (auto& start : ends) {
+            int s = start[0], p = start[1];
+            while (true) {
+                int bs = top(s);
+                if (bs >= n) augmentBlossom(bs, s);
+                mate[s] = p;
+                if (labelEnd[bs] == -1) break;
+                int t = endpoint[labelEnd[bs]];
+                int bt = top(t);
+                s = endpoint[labelEnd[bt]];
+                int j = endpoint[labelEnd[bt] ^ 1];
+                if (bt >= n) augmentBlossom(bt, j);
+                mate[j] = labelEnd[bt];
+                p = labelEnd[bt] ^ 1;
+            }
+        }
+    }
+};
+
+// Minimum-weight perfect matching of the odd vertices, solved exactly on a
+// sparse candidate graph: the k nearest odd neighbours of every vertex plus
+// the greedy matching, which guarantees that a perfect matching exists.
+// Lengths are scaled to integers (about 1e9 for the longest candidate edge)
+// and matched as max-cardinality matching with weight maxLength - length.
+vector<pair<int, int>> minWeightMatching(const vector<Point>& points, const vector<int>& oddVertices, int k = 10) {
+    ScopedPhase phase("matching");
+    int m = oddVertices.size();
+    if (m == 0) return {};
+
+    vector<Point> oddPoints;
+    oddPoints.reserve(m);
+    for (int v : oddVertices) oddPoints.push_back(points[v]);
+
+    vector<int> local(points.size(), -1);
+    for (int i = 0; i < m; i++) local[oddVertices[i]] = i;
+
+    vector<pair<int, int>> pairs;
+    KdTree tree(oddPoints);
+    for (int i = 0; i < m; i++) {
+        for (int j : tree.kNearest(i, k)) pairs.push_back({min(i, j), max(i, j)});
+    }
+    for (const auto& edge : improvedMatching(points, oddVertices, k)) {
+        int i = local[edge.first], j = local[edge.second];
+        pairs.push_back({min(i, j), max(i, j)});
+    }
+    sort(pairs.begin(), pairs.end());
+    pairs.erase(unique(pairs.begin(), pairs.end()), pairs.end());
+
+    double maxLength = 0;
+    for (const auto& pr : pairs) maxLength = max(maxLength, distance(oddPoints[pr.first], oddPoints[pr.second]));
+    double scale = maxLength > 0 ? 1e9 / maxLength : 1.0;
+    long long top = (long long)llround(maxLength * scale) + 1;
+
+    countEvent(kDistanceEvaluations, 2 * pairs.size());
+    vector<BlossomMatching::Edge> edges;
+    edges.reserve(pairs.size());
+    for (const auto& pr : pairs) {
+        long long length = llround(distance(oddPoints[pr.first], oddPoints[pr.second]) * scale);
+        edges.push_back({pr.first, pr.second, top - length});
+    }
+
+    // The greedy matching's pairs are in the edge set, so a perfect matching exists
+    vector<int> mate = BlossomMatching(m, edges, true, true).solve();
+
+    vector<pair<int, int>> matching;
+    matching.reserve(m / 2);
+    for (int i = 0; i < m; i++) {
+        if (mate[i] > i) matching.push_back({oddVertices[i], oddVertices[mate[i]]});
+    }
+    return matching;
+}
+
+// Euler circuit of a connected multigraph with even degrees, shortcut to a
+// Hamiltonian tour in the same pass. Edges live once in a flat array with
+// a used flag, adjacency is CSR over edge ids, and Hierholzer's algorithm
+// runs on an explicit stack. A vertex is emitted the first time it is
+// popped, which shortcuts the (reversed) circuit.
+vector<int> buildTourFromEulerGraph(const vector<pair<int, int>>& edges, int n) {
+    ScopedPhase phase("euler");
+    vector<int> offset(n + 1, 0);
+    for (const auto& edge : edges) {
+        offset[edge.first + 1]++;
+        offset[edge.second + 1]++;
+    }
+    for (int v = 0; v < n; v++) offset[v + 1] += offset[v];
+
+    vector<int> adj(offset[n]);
+    vector<int> fillPos(offset.begin(), offset.end() - 1);
+    for (int e = 0; e < (int)edges.size(); e++) {
+        adj[fillPos[edges[e].first]++] = e;
+        adj[fillPos[edges[e].second]++] = e;
+    }
+
+    vector<char> used(edges.size(), 0);
+    vector<int>& next = fillPos;
+    copy(offset.begin(), offset.end() - 1, next.begin());
+
+    vector<char> visited(n, 0);
+    vector<int> tour;
+    tour.reserve(n);
+    vector<int> stack;
+    if (n > 0) stack.push_back(0);
+
+    while (!stack.empty()) {
+        int u = stack.back();
+        while (next[u] < offset[u + 1] && used[adj[next[u]]]) next[u]++;
+
+        if (next[u] == offset[u + 1]) {
+            stack.pop_back();
+            if (!visited[u]) {
+                visited[u] = 1;
+                tour.push_back(u);
+            }
+        } else {
+            int e = adj[next[u]++];
+            used[e] = 1;
+            stack.push_back(edges[e].first == u ? edges[e].second : edges[e].first);
+        }
+    }
+
+    return tour;
+}
+
+// tree must have every point alive; it is consumed by the walk.
+vector<int> nearestNeighbor(const vector<Point>& points, KdTree& tree, int start = 0) {
+    ScopedPhase phase("nn");
+    int n = points.size();
+    vector<int> tour;
+    if (n == 0) return tour;
+    tour.reserve(n);
+
+    int current = start;
+    tour.push_back(current);
+    tree.remove(current);
+
+    for (int i = 1; i < n; i++) {
+        current = tree.nearest(points[current].x, points[current].y);
+        tour.push_back(current);
+        tree.remove(current);
+    }
+
+    traceTour(points, tour);
+    return tour;
+}
+
+// Below this size a vectorised linear scan beats the k-d tree queries
+const int kBruteForceNNMaxSize = 2048;
+
+vector<int> nearestNeighborBruteForce(const vector<Point>& points, int start = 0) {
+    ScopedPhase phase("nn");
+    int n = points.size();
+    vector<int> tour;
+    if (n == 0) return tour;
+    tour.reserve(n);
+
+    Coordinates rest(points);
+    int current = start;
+    tour.push_back(current);
+    rest.remove(current);
+
+    while (rest.size() > 0) {
+        int slot = nearestSquared(rest.x.data(), rest.y.data(), rest.idx.data(), rest.size(),
+                                  points[current].x, points[current].y);
+        current = rest.idx[slot];
+        tour.push_back(current);
+        rest.remove(slot);
+    }
+
+    traceTour(points, tour);
+    return tour;
+}
+
+vector<int> nearestNeighbor(const vector<Point>& points, int start = 0) {
+    if ((int)points.size() <= kBruteForceNNMaxSize) return nearestNeighborBruteForce(points, start);
+    KdTree tree(points);
+    return nearestNeighbor(points, tree, start);
+}
+
+// Local search over candidate lists, driven by a queue of cities whose
+// don't-look bit is off. A city leaves the queue when no improving move
+// starts at it and re-enters when one of its tour edges changes.
+// Tour is any representation with next/prev/between/reverse. Applied moves
+// can be journaled so that a run is rolled back with undo(). Neighbors is
+// NeighborLists, or LazyNeighborLists for a single-threaded sparse search.
+template <class Tour, class Neighbors = const NeighborLists>
+class LocalSearch {
+public:
+    LocalSearch(const vector<Point>& points, Tour& tour, Neighbors& neighbors)
+        : points(points), t(tour), neighbors(neighbors), queued(tour.size(), 0) {}
+
+    void push(int c) {
+        if (!queued[c]) {
+            queued[c] = 1;
+            queue.push_back(c);
+        }
+    }
+
+    void pushAll(const vector<int>& order) {
+        for (int c : order) push(c);
+    }
+
+    // Use a depth-limited Lin-Kernighan chain instead of a single 2-opt
+    // move at every city; 0 turns it off.
+    void setLinKernighan(int maxDepth) {
+        lkDepth = max(0, maxDepth);
+    }
+
+    // Also try segment insertion (Or-opt) for segments of up to maxSegment
+    // cities; 0 turns it off.
+    void setOrOpt(int maxSegment) {
+        orOptSegment = max(0, min({maxSegment, 64, t.size() - 5}));
+    }
+
+    // Empty the queue; returns the total change of the tour length.
+    double run() {
+        ScopedPhase phase("local_search");
+        double total = 0;
+        long long applied = 0;
+        while (!queue.empty()) {
+            int a = queue.front();
+            queue.pop_front();
+            queued[a] = 0;
+            double delta = lkDepth > 0 ? improveLinKernighan(a) : improveTwoOpt(a);
+            if (delta == 0 && orOptSegment > 0) delta = improveOrOpt(a);
+            if (delta < 0) applied++;
+            total += delta;
+        }
+        countEvent(kSearchRuns);
+        countEvent(kMovesApplied, applied);
+        countEvent(kMovesTried, tried);
+        countEvent(kDistanceEvaluations, evaluations);
+        tried = 0;
+        evaluations = 0;
+        return total;
+    }
+
+    // Remove edges (a, b) and (c, d), add (a, c) and (b, d). b and d must
+    // follow a and c in the same direction.
+    void move2(int a, int b, int c, int d) {
+        if (t.next(a) == b) {
+            t.reverse(b, c);
+        } else {
+            t.reverse(a, d);
+        }
+        if (journaling) journal.push_back({a, b, c, d});
+    }
+
+    void startJournal() {
+        journal.clear();
+        journaling = true;
+    }
+
+    void stopJournal() {
+        journaling = false;
+    }
+
+    void undo() {
+        journaling = false;
+        for (auto it = journal.rbegin(); it != journal.rend(); ++it) {
+            move2((*it)[0], (*it)[2], (*it)[1], (*it)[3]);
+        }
+        journal.clear();
+    }
+
+private:
+    const vector<Point>& points;
+    Tour& t;
+    Neighbors& neighbors;
+    vector<char> queued;
+    deque<int> queue;
+    vector<array<int, 4>> journal;
+    bool journaling = false;
+    int orOptSegment = 0;
+    int lkDepth = 0;
+    vector<array<int, 4>> chain;
+    vector<pair<int, int>> chainAdded;
+    vector<pair<int, int>> chainRemoved;
+    double chainBestGain = 0;
+    int chainBestLength = 0;
+    long long tried = 0;
+    long long evaluations = 0;  // dist() calls, reported per run
+
+    double dist(int a, int b) {
+        evaluations++;
+        return distance(points[a], points[b]);
+    }
+
+    double improveTwoOpt(int a) {
+        double bestDelta = -1e-9;
+        int bestDir = -1, bestC = -1;
+        for (int dir = 0; dir < 2; dir++) {
+            int b = dir == 0 ? t.next(a) : t.prev(a);
+            double dab = dist(a, b);
+
+            for (const int* it = neighbors.begin(a); it != neighbors.end(a); ++it) {
+                int c = *it;
+                double dac = dist(a, c);
+                if (dac >= dab) break;
+
+                int d = dir == 0 ? t.next(c) : t.prev(c);
+                if (c == b || d == a) continue;
+
+                tried++;
+                double delta = dac + dist(b, d) - dab - dist(c, d);
+                if (delta < bestDelta) {
+                    bestDelta = delta;
+                    bestDir = dir;
+                    bestC = c;
+                }
+            }
+        }
+
+        if (bestDir == -1) return 0;
+
+        int c = bestC;
+        int b = bestDir == 0 ? t.next(a) : t.prev(a);
+        int d = bestDir == 0 ? t.next(c) : t.prev(c);
+        move2(a, b, c, d);
+        push(a); push(b); push(c); push(d);
+        return bestDelta;
+    }
+
+    // Lin-Kernighan step with 2-opt basis moves: t1 stays fixed, edge
+    // (t1, t2) is broken, (t2, t3) added for a candidate t3 and the tour
+    // closed through t4, then the chain continues from t4. The first two
+    // levels try several t3 (breadth 5 and 3), deeper levels only the best.
+    // Added edges are never removed and removed edges never re-added. The
+    // prefix of the chain with the largest gain is kept.
+    double improveLinKernighan(int t1) {
+        for (int dir = 0; dir < 2; dir++) {
+            int t2 = dir == 0 ? t.next(t1) : t.prev(t1);
+            chain.clear();
+            chainAdded.clear();
+            chainRemoved.assign(1, {t1, t2});
+            chainBestGain = 1e-9;
+            chainBestLength = 0;
+
+            linKernighanStep(t1, t2, dist(t1, t2), 1);
+
+            if (chainBestLength > 0) {
+                while ((int)chain.size() > chainBestLength) undoChainMove();
+                for (const auto& move : chain) {
+                    for (int c : move) push(c);
+                }
+                return -chainBestGain;
+            }
+        }
+        return 0;
+    }
+
+    static bool hasEdge(const vector<pair<int, int>>& edges, int a, int b) {
+        for (const auto& e : edges) {
+            if ((e.first == a && e.second == b) || (e.first == b && e.second == a)) return true;
+        }
+        return false;
+    }
+
+    void linKernighanStep(int t1, int t2, double gain, int level) {
+        struct Alternative {
+            double score;
+            int t3, t4;
+        };
+        Alternative alts[64];
+        int count = 0;
+
+        bool t1AfterT2 = t.next(t2) == t1;
+        for (const int* it = neighbors.begin(t2); it != neighbors.end(t2); ++it) {
+            int t3 = *it;
+            double g1 = gain - dist(t2, t3);
+            if (g1 <= 0) break;
+            if (t3 == t1 || t3 == t.next(t2) || t3 == t.prev(t2)) continue;
+
+            int t4 = t1AfterT2 ? t.next(t3) : t.prev(t3);
+            if (hasEdge(chainRemoved, t2, t3) || hasEdge(chainAdded, t3, t4)) continue;
+            tried++;
+            alts[count++] = {g1 + dist(t3, t4), t3, t4};
+            if (count == 64) break;
+        }
+
+        int breadth = level == 1 ? 5 : level == 2 ? 3 : 1;
+        sort(alts, alts + count, [](const Alternative& x, const Alternative& y) { return x.score > y.score; });
+
+        for (int k = 0; k < min(breadth, count); k++) {
+            int t3 = alts[k].t3, t4 = alts[k].t4;
+            move2(t2, t1, t3, t4);
+            chain.push_back({t2, t1, t3, t4});
+            chainAdded.push_back({t2, t3});
+            chainRemoved.push_back({t3, t4});
+
+            double closed = alts[k].score - dist(t4, t1);
+            if (closed > chainBestGain) {
+                chainBestGain = closed;
+                chainBestLength = chain.size();
+            }
+            if (level < lkDepth) linKernighanStep(t1, t4, alts[k].score, level + 1);
+            if (chainBestLength > 0) return;
+
+            undoChainMove();
+        }
+    }
+
+    void undoChainMove() {
+        const auto& m = chain.back();
+        move2(m[0], m[2], m[1], m[3]);
+        chain.pop_back();
+        chainAdded.pop_back();
+        chainRemoved.pop_back();
+    }
+
+    // Move a segment that has a at one end next to a candidate neighbour c
+    // of a, between c and one of its tour neighbours, in either
+    // orientation. The segment grows from a in both tour directions.
+    double improveOrOpt(int a) {
+        double bestDelta = -1e-9;
+        int bestS1 = -1, bestS2 = -1, bestU = -1;
+        bool bestForward = false;
+
+        int segment[64];
+        for (int dir = 0; dir < 2; dir++) {
+            int e2 = a;
+            segment[0] = a;
+            int outside = dir == 0 ? t.prev(a) : t.next(a);
+            double dOut = dist(outside, a);
+
+            for (int len = 1; len <= orOptSegment; len++) {
+                if (len > 1) {
+                    e2 = dir == 0 ? t.next(e2) : t.prev(e2);
+                    segment[len - 1] = e2;
+                }
+                int s1 = dir == 0 ? a : e2, s2 = dir == 0 ? e2 : a;
+                int p = t.prev(s1), nx = t.next(s2);
+                if (nx == p) break;
+                double removed = dist(p, s1) + dist(s2, nx) - dist(p, nx);
+
+                for (const int* it = neighbors.begin(a); it != neighbors.end(a); ++it) {
+                    int c = *it;
+                    double dac = dist(a, c);
+                    if (dac >= dOut) break;
+
+                    for (int side = 0; side < 2; side++) {
+                        int u = side == 0 ? c : t.prev(c);
+                        int v = side == 0 ? t.next(c) : c;
+                        if (u == p || v == p) continue;
+                        if (find(segment, segment + len, u) != segment + len) continue;
+                        if (find(segment, segment + len, v) != segment + len) continue;
+
+                        tried++;
+                        bool forward = (c == u) == (a == s1);
+                        double added = forward ? dist(u, s1) + dist(s2, v) : dist(u, s2) + dist(s1, v);
+                        double delta = added - dist(u, v) - removed;
+                        if (delta < bestDelta) {
+                            bestDelta = delta;
+                            bestS1 = s1;
+                            bestS2 = s2;
+                            bestU = u;
+                            bestForward = forward;
+                        }
+                    }
+                }
+            }
+        }
+
+        if (bestS1 == -1) return 0;
+
+        // With S = s1..s2 and M = nx..u the tour is p S M v; two 2-opt moves
+        // give p M S' v, a third one turns S' back into S.
+        int s1 = bestS1, s2 = bestS2, u = bestU;
+        int p = t.prev(s1), nx = t.next(s2), v = t.next(u);
+        move2(p, s1, u, v);
+        move2(p, u, nx, s2);
+        if (bestForward) move2(u, s2, s1, v);
+        push(p); push(nx); push(s1); push(s2); push(u); push(v);
+        return bestDelta;
+    }
+};
+
+const int kTwoLevelMinSize = 50000;
+const int kOr3OptSegment = 30;
+
+void twoOptNeighbors(const vector<Point>& points, vector<int>& tour, const NeighborLists& neighbors) {
+    if (tour.size() < 5) return;
+
+    if ((int)tour.size() >= kTwoLevelMinSize) {
+        TwoLevelTour t(tour);
+        LocalSearch<TwoLevelTour> search(points, t, neighbors);
+        search.pushAll(tour);
+        search.run();
+        tour = t.cities();
+    } else {
+        ArrayTour t(tour);
+        LocalSearch<ArrayTour> search(points, t, neighbors);
+        search.pushAll(tour);
+        search.run();
+        tour = t.cities();
+    }
+    traceTour(points, tour);
+}
+
+vector<int> tsp2Approx(const vector<Point>& points) {
+    int n = points.size();
+    vector<pair<int, int>> mst = buildMST(points);
+    
+    vector<pair<int, int>> eulerGraph = mst;
+    eulerGraph.insert(eulerGraph.end(), mst.begin(), mst.end());
+    
+    return buildTourFromEulerGraph(eulerGraph, n);
+}
+
+vector<int> tsp15Approx(const vector<Point>& points) {
+    int n = points.size();
+    vector<pair<int, int>> mst = buildMST(points);
+    vector<int> oddVertices = getOddDegreeVertices(n, mst);
+    vector<pair<int, int>> matching = minWeightMatching(points, oddVertices);
+    
+    vector<pair<int, int>> eulerGraph = mst;
+    eulerGraph.insert(eulerGraph.end(), matching.begin(), matching.end());
+    
+    return buildTourFromEulerGraph(eulerGraph, n);
+}
+
+vector<int> tsp15ApproxImproved(const vector<Point>& points) {
+    int n = points.size();
+    vector<pair<int, int>> mst = buildMST(points);
+    vector<int> oddVertices = getOddDegreeVertices(n, mst);
+    vector<pair<int, int>> matching = improvedMatching(points, oddVertices);
+    
+    vector<pair<int, int>> eulerGraph = mst;
+    eulerGraph.insert(eulerGraph.end(), matching.begin(), matching.end());
+    
+    return buildTourFromEulerGraph(eulerGraph, n);
+}
+
+// Nearest Neighbor с 2-opt
+vector<int> nnWith2Opt(const vector<Point>& points, const NeighborLists& neighbors) {
+    vector<int> tour = nearestNeighbor(points);
+    twoOptNeighbors(points, tour, neighbors);
+    return tour;
+}
+
+vector<int> nnWith2Opt(const vector<Point>& points) {
+    return nnWith2Opt(points, buildNeighborLists(points, 10));
+}
+
+template <class Tour>
+void twoOptOrOpt(const vector<Point>& points, Tour& t, const vector<int>& tour, const NeighborLists& neighbors) {
+    LocalSearch<Tour> search(points, t, neighbors);
+    search.pushAll(tour);
+    search.run();
+    if (metrics.enabled) traceTour(points, t.cities());
+
+    search.setOrOpt(3);
+    search.pushAll(tour);
+    search.run();
+    if (metrics.enabled) traceTour(points, t.cities());
+
+    search.setOrOpt(kOr3OptSegment);
+    search.pushAll(tour);
+    search.run();
+}
+
+const int kLinKernighanDepth = 30;
+
+// Lin-Kernighan (2-opt basis moves, depth 30) plus Or-opt on a tour.
+void linKernighan(const vector<Point>& points, vector<int>& tour, const NeighborLists& neighbors) {
+    if (tour.size() < 8) return;
+
+    auto optimize = [&](auto& t) {
+        LocalSearch<std::decay_t<decltype(t)>> search(points, t, neighbors);
+        search.setLinKernighan(kLinKernighanDepth);
+        search.setOrOpt(3);
+        search.pushAll(tour);
+        search.run();
+        tour = t.cities();
+        traceTour(points, tour);
+    };
+    if ((int)tour.size() >= kTwoLevelMinSize) {
+        TwoLevelTour t(tour);
+        optimize(t);
+    } else {
+        ArrayTour t(tour);
+        optimize(t);
     }
 }
 
-double tourLength(const vector<Point>& points, const vector<int>& tour) {
-    double total = 0.0;
-    int n = tour.size();
-    for (int i = 0; i < n; i++) {
-        total += distance(points[tour[i]], points[tour[(i + 1) % n]]);
+// NN, then candidate 2-opt, then 2-opt together with Or-opt (segments of
+// 1-3 cities, with or without reversal), then the same with longer
+// segments (segment-insertion 3-opt). Every stage restarts from the
+// queue of all cities and keeps the previous moves enabled.
+vector<int> nnWith2Opt3Opt(const vector<Point>& points) {
+    vector<int> tour = nearestNeighbor(points);
+    if (tour.size() < 8) return tour;
+
+    NeighborLists neighbors = buildNeighborLists(points, 10);
+    if ((int)tour.size() >= kTwoLevelMinSize) {
+        TwoLevelTour t(tour);
+        twoOptOrOpt(points, t, tour, neighbors);
+        return t.cities();
     }
-    return total;
+    ArrayTour t(tour);
+    twoOptOrOpt(points, t, tour, neighbors);
+    return t.cities();
 }
 
-vector<int> tourIndicesToIds(const vector<Point>& points, const vector<int>& tour) {
-    vector<int> result;
-    result.reserve(tour.size());
-    for (int idx : tour) {
-        result.push_back(points[idx].id);
+// ============================================================================
+// LOWER BOUND
+// ============================================================================
+
+// Minimum 1-tree under node penalties pi over the complete graph: dense
+// Prim over cities 1..n-1 plus the two cheapest edges at city 0. Every tour
+// is such a 1-tree, so the weight minus 2 * sum(pi) is a valid lower bound
+// for any pi. O(n^2), the remaining cities are kept compacted.
+double oneTreeBound(const vector<Point>& points, const vector<double>& pi) {
+    int n = points.size();
+    vector<double> xs, ys, ps, key;
+    for (int v = 1; v < n; v++) {
+        xs.push_back(points[v].x);
+        ys.push_back(points[v].y);
+        ps.push_back(pi[v]);
+        key.push_back(numeric_limits<double>::infinity());
     }
-    return result;
+
+    double weight = 0;
+    int m = n - 1;
+    int u = 0;  // index into the compacted arrays
+    while (m > 1) {
+        double ux = xs[u], uy = ys[u], up = ps[u];
+        m--;
+        xs[u] = xs[m];
+        ys[u] = ys[m];
+        ps[u] = ps[m];
+        key[u] = key[m];
+
+        int next = 0;
+        for (int v = 0; v < m; v++) {
+            double dx = xs[v] - ux, dy = ys[v] - uy;
+            double w = sqrt(dx * dx + dy * dy) + up + ps[v];
+            if (w < key[v]) key[v] = w;
+            if (key[v] < key[next]) next = v;
+        }
+        weight += key[next];
+        u = next;
+    }
+
+    double first = numeric_limits<double>::infinity(), second = first;
+    for (int v = 1; v < n; v++) {
+        double w = distance(points[0], points[v]) + pi[0] + pi[v];
+        if (w < first) {
+            second = first;
+            first = w;
+        } else if (w < second) {
+            second = w;
+        }
+    }
+    weight += first + second;
+
+    double penalties = 0;
+    for (int v = 0; v < n; v++) penalties += pi[v];
+    return weight - 2 * penalties;
 }
 
-vector<vector<int>> buildMST(const vector<Point>& points) {
+// The exact 1-tree is quadratic; above this --gap is not available
+const int kLowerBoundMaxSize = 50000;
+
+// Held-Karp bound: the largest weight of a minimum 1-tree under node
+// penalties pi, found by subgradient steps (Polyak step towards
+// upperBound, halved after 3 iterations without progress). The steps take
+// 1-trees over the MST plus the candidate edges, as LKH does; that weight
+// is not a bound, so the best penalties are finally evaluated by
+// oneTreeBound over the complete graph.
+double heldKarpBound(const vector<Point>& points, const NeighborLists& neighbors,
+                     double upperBound, int iterations = 50) {
+    ScopedPhase phase("lower_bound");
     int n = points.size();
-    vector<vector<int>> mst(n);
-    vector<bool> inMST(n, false);
-    vector<double> minDist(n, 1e18);
-    vector<int> parent(n, -1);
-    
-    minDist[0] = 0.0;
-    
+    if (n < 3) return n == 2 ? 2 * distance(points[0], points[1]) : 0.0;
+
+    vector<pair<int, int>> edges = buildMST(points);
     for (int i = 0; i < n; i++) {
-        int u = -1;
-        double minVal = 1e18;
-        for (int j = 0; j < n; j++) {
-            if (!inMST[j] && minDist[j] < minVal) {
-                minVal = minDist[j];
-                u = j;
-            }
-        }
-        
-        if (u == -1) break;
-        inMST[u] = true;
-        
-        if (parent[u] != -1) {
-            mst[u].push_back(parent[u]);
-            mst[parent[u]].push_back(u);
-        }
-        
-        for (int v = 0; v < n; v++) {
-            if (!inMST[v]) {
-                double dist = distance(points[u], points[v]);
-                if (dist < minDist[v]) {
-                    minDist[v] = dist;
+        for (const int* it = neighbors.begin(i); it != neighbors.end(i); ++it) edges.push_back({i, *it});
+    }
+    vector<int> start(n + 1, 0), adj(2 * edges.size());
+    for (const auto& e : edges) {
+        start[e.first + 1]++;
+        start[e.second + 1]++;
+    }
+    for (int i = 0; i < n; i++) start[i + 1] += start[i];
+    vector<int> fill(start.begin(), start.end() - 1);
+    for (const auto& e : edges) {
+        adj[fill[e.first]++] = e.second;
+        adj[fill[e.second]++] = e.first;
+    }
+    vector<double> length(adj.size());
+    for (int u = 0; u < n; u++) {
+        for (int k = start[u]; k < start[u + 1]; k++) length[k] = distance(points[u], points[adj[k]]);
+    }
+
+    vector<double> pi(n, 0.0), bestPi(pi), key(n);
+    vector<int> parent(n), degree(n);
+    vector<char> inTree(n);
+    double best = -numeric_limits<double>::infinity();
+    double step = 1.0;
+    int stall = 0;
+
+    for (int iter = 0; iter < iterations; iter++) {
+        // Prim over the candidate graph with penalised weights
+        std::fill(key.begin(), key.end(), numeric_limits<double>::infinity());
+        std::fill(parent.begin(), parent.end(), -1);
+        std::fill(degree.begin(), degree.end(), 0);
+        std::fill(inTree.begin(), inTree.end(), 0);
+        priority_queue<pair<double, int>, vector<pair<double, int>>, greater<pair<double, int>>> heap;
+        key[0] = 0;
+        heap.push({0.0, 0});
+        double weight = 0;
+        while (!heap.empty()) {
+            auto [k, u] = heap.top();
+            heap.pop();
+            if (inTree[u] || k > key[u]) continue;
+            inTree[u] = 1;
+            weight += k;
+            if (parent[u] >= 0) {
+                degree[u]++;
+                degree[parent[u]]++;
+            }
+            for (int e = start[u]; e < start[u + 1]; e++) {
+                int v = adj[e];
+                double w = length[e] + pi[u] + pi[v];
+                if (!inTree[v] && w < key[v]) {
+                    key[v] = w;
                     parent[v] = u;
+                    heap.push({w, v});
+                }
+            }
+        }
+
+        // Close the 1-tree at the leaf whose second cheapest edge is longest
+        int leaf = -1, other = -1;
+        double closing = -numeric_limits<double>::infinity();
+        for (int u = 0; u < n; u++) {
+            if (degree[u] != 1) continue;
+            double cheapest = numeric_limits<double>::infinity();
+            int to = -1;
+            for (int e = start[u]; e < start[u + 1]; e++) {
+                int v = adj[e];
+                if (v == parent[u] || parent[v] == u) continue;
+                double w = length[e] + pi[u] + pi[v];
+                if (w < cheapest) {
+                    cheapest = w;
+                    to = v;
                 }
             }
+            if (to >= 0 && cheapest > closing) {
+                closing = cheapest;
+                leaf = u;
+                other = to;
+            }
+        }
+        if (leaf < 0) break;
+        weight += closing;
+        degree[leaf]++;
+        degree[other]++;
+
+        double penalties = 0;
+        for (int u = 0; u < n; u++) penalties += pi[u];
+        double bound = weight - 2 * penalties;
+        if (bound > best + 1e-9) {
+            best = bound;
+            bestPi = pi;
+            stall = 0;
+        } else if (++stall >= 3) {
+            step /= 2;
+            stall = 0;
         }
+
+        double norm = 0;
+        for (int u = 0; u < n; u++) norm += (double)(degree[u] - 2) * (degree[u] - 2);
+        if (norm == 0) break;  // the 1-tree is a tour
+        double t = step * (upperBound - bound) / norm;
+        for (int u = 0; u < n; u++) pi[u] += t * (degree[u] - 2);
     }
-    
-    return mst;
+    return oneTreeBound(points, bestPi);
+}
+
+struct Options {
+    int threads = max(1u, thread::hardware_concurrency());
+    int starts = 16;
+    unsigned seed = 1;
+    double timeLimit = 10.0;
+    bool hilbertOrder = false;
+    double gap = 0;         // stop once within this many percent of lowerBound
+    double lowerBound = 0;
+    string prevTour;        // incremental: previous output and point diff
+    string diffFile;
+    string metricsFile;     // JSON report of phases, counters and trace
+};
+
+bool withinGap(double length, const Options& opts) {
+    return opts.gap > 0 && opts.lowerBound > 0 && length <= opts.lowerBound * (1 + opts.gap / 100);
 }
 
-void eulerTourDFS(vector<vector<int>>& graph, int u, vector<int>& euler) {
-    while (!graph[u].empty()) {
-        int v = graph[u].back();
-        graph[u].pop_back();
-        
-        auto it = find(graph[v].begin(), graph[v].end(), u);
-        if (it != graph[v].end()) {
-            graph[v].erase(it);
+// NN + local search from several start cities in parallel, best tour
+// wins. Start cities come from a generator seeded with opts.seed and every
+// start is solved independently, so the result does not depend on the
+// number of threads. With --gap the remaining starts are skipped once a
+// tour is close enough to the lower bound.
+template <class Improve>
+vector<int> multiStartNN(const vector<Point>& points, const Options& opts, const Improve& improve) {
+    int n = points.size();
+    if (n == 0) return {};
+
+    vector<int> starts;
+    if (opts.starts >= n) {
+        for (int i = 0; i < n; i++) starts.push_back(i);
+    } else {
+        mt19937 rng(opts.seed);
+        vector<char> taken(n, 0);
+        while ((int)starts.size() < opts.starts) {
+            int city = rng() % n;
+            if (!taken[city]) {
+                taken[city] = 1;
+                starts.push_back(city);
+            }
         }
-        
-        eulerTourDFS(graph, v, euler);
     }
-    euler.push_back(u);
+
+    NeighborLists neighbors = buildNeighborLists(points, 10);
+    KdTree baseTree(points);
+
+    // --gap cutoff: firstHit is the lowest start index whose tour is within
+    // the gap. Starts above it are skipped and the best is taken over
+    // 0..firstHit only, which every thread count runs in full, so the
+    // result does not depend on scheduling.
+    vector<vector<int>> tours(starts.size());
+    vector<double> lengths(starts.size(), numeric_limits<double>::infinity());
+    atomic<int> firstHit((int)starts.size() - 1);
+    parallelFor(starts.size(), opts.threads, [&](int i) {
+        if (i > firstHit) return;
+        KdTree tree(baseTree);
+        tours[i] = nearestNeighbor(points, tree, starts[i]);
+        improve(tours[i], neighbors);
+        lengths[i] = tourLength(points, tours[i]);
+        if (withinGap(lengths[i], opts)) {
+            int seen = firstHit;
+            while (i < seen && !firstHit.compare_exchange_weak(seen, i)) {}
+        }
+    });
+
+    int best = min_element(lengths.begin(), lengths.begin() + firstHit + 1) - lengths.begin();
+    return tours[best];
 }
 
-vector<int> getOddDegreeVertices(const vector<vector<int>>& mst) {
-    vector<int> odd;
-    for (int i = 0; i < (int)mst.size(); i++) {
-        if (mst[i].size() % 2 == 1) {
-            odd.push_back(i);
+vector<int> multiNNWith2Opt(const vector<Point>& points, const Options& opts) {
+    return multiStartNN(points, opts, [&](vector<int>& tour, const NeighborLists& neighbors) {
+        twoOptNeighbors(points, tour, neighbors);
+    });
+}
+
+vector<int> multiNNFull(const vector<Point>& points, const Options& opts) {
+    return multiStartNN(points, opts, [&](vector<int>& tour, const NeighborLists& neighbors) {
+        linKernighan(points, tour, neighbors);
+    });
+}
+
+// Christofides tour (exact matching) polished with Lin-Kernighan + Or-opt
+vector<int> christofidesFull(const vector<Point>& points) {
+    vector<int> tour = tsp15Approx(points);
+    linKernighan(points, tour, buildNeighborLists(points, 10));
+    return tour;
+}
+
+// Iterated local search until the deadline or until the tour is within
+// --gap of the lower bound. Each kick is a local double bridge: two short
+// adjacent segments after a random city swap places (A B C D -> A C B D),
+// done as three journaled 2-opt moves so it costs O(segment) on any tour
+// representation. Only the kick endpoints are queued for 2-opt; if the
+// result is longer the journal is undone.
+template <class Tour>
+void iteratedLocalSearch(const vector<Point>& points, Tour& t, const vector<int>& tour,
+                         const NeighborLists& neighbors, const Options& opts,
+                         steady_clock::time_point deadline) {
+    int n = t.size();
+    auto dist = [&](int a, int b) { return distance(points[a], points[b]); };
+
+    LocalSearch<Tour> search(points, t, neighbors);
+    search.pushAll(tour);
+    double length = tourLength(points, tour) + search.run();
+
+    mt19937 rng(opts.seed);
+    const int maxSegment = min(50, (n - 2) / 2);
+    while (!withinGap(length, opts) && steady_clock::now() < deadline) {
+        int a = rng() % n;
+        int l1 = 1 + rng() % maxSegment;
+        int l2 = 1 + rng() % maxSegment;
+
+        int b1 = t.next(a), b2 = b1;
+        for (int k = 1; k < l1; k++) b2 = t.next(b2);
+        int c1 = t.next(b2), c2 = c1;
+        for (int k = 1; k < l2; k++) c2 = t.next(c2);
+        int d = t.next(c2);
+
+        double delta = dist(a, c1) + dist(c2, b1) + dist(b2, d)
+                     - dist(a, b1) - dist(b2, c1) - dist(c2, d);
+
+        countEvent(kKicks);
+        search.startJournal();
+        search.move2(a, b1, c2, d);
+        search.move2(a, c2, c1, b2);
+        search.move2(c2, b2, b1, d);
+        search.push(a); search.push(b1); search.push(b2);
+        search.push(c1); search.push(c2); search.push(d);
+        delta += search.run();
+
+        if (delta > 0) {
+            search.undo();
+        } else {
+            search.stopJournal();
+            length += delta;
+            if (metrics.enabled && delta < 0) metrics.addLength(length);
         }
     }
-    return odd;
 }
 
-vector<pair<int, int>> improvedMatching(const vector<Point>& points, const vector<int>& oddVertices) {
-    vector<pair<double, pair<int, int>>> edges;
-    for (int i = 0; i < (int)oddVertices.size(); i++) {
-        for (int j = i + 1; j < (int)oddVertices.size(); j++) {
-            double dist = distance(points[oddVertices[i]], points[oddVertices[j]]);
-            edges.push_back({dist, {i, j}});
+vector<int> iteratedLocalSearch(const vector<Point>& points, const Options& opts) {
+    auto deadline = steady_clock::now() +
+                    duration_cast<steady_clock::duration>(duration<double>(opts.timeLimit));
+    NeighborLists neighbors = buildNeighborLists(points, 10, opts.threads);
+    vector<int> tour = nnWith2Opt(points, neighbors);
+    if (tour.size() < 8) return tour;
+
+    if ((int)tour.size() >= kTwoLevelMinSize) {
+        TwoLevelTour t(tour);
+        iteratedLocalSearch(points, t, tour, neighbors, opts, deadline);
+        return t.cities();
+    }
+    ArrayTour t(tour);
+    iteratedLocalSearch(points, t, tour, neighbors, opts, deadline);
+    return t.cities();
+}
+
+// ============================================================================
+// PARTITIONING
+// ============================================================================
+
+const int kRegionSize = 5000;
+
+// Karp-style recursive bisection: cities[begin, end) is split at the median
+// of the longer side of its bounding box until at most maxSize are left.
+void bisectRegions(const vector<Point>& points, vector<int>& cities, int begin, int end,
+                   int maxSize, vector<pair<int, int>>& regions) {
+    if (end - begin <= maxSize) {
+        regions.push_back({begin, end});
+        return;
+    }
+
+    double minX = numeric_limits<double>::max(), minY = minX;
+    double maxX = -minX, maxY = -minX;
+    for (int k = begin; k < end; k++) {
+        const Point& p = points[cities[k]];
+        minX = min(minX, p.x); maxX = max(maxX, p.x);
+        minY = min(minY, p.y); maxY = max(maxY, p.y);
+    }
+
+    int mid = begin + (end - begin) / 2;
+    if (maxX - minX >= maxY - minY) {
+        nth_element(cities.begin() + begin, cities.begin() + mid, cities.begin() + end,
+                    [&](int a, int b) { return points[a].x < points[b].x; });
+    } else {
+        nth_element(cities.begin() + begin, cities.begin() + mid, cities.begin() + end,
+                    [&](int a, int b) { return points[a].y < points[b].y; });
+    }
+    bisectRegions(points, cities, begin, mid, maxSize, regions);
+    bisectRegions(points, cities, mid, end, maxSize, regions);
+}
+
+// Large instances: regions of at most kRegionSize cities are solved with
+// nnWith2Opt in parallel, visited in Hilbert order of their centroids and
+// spliced into one tour at the border of consecutive regions (see below).
+// A 2-opt + Or-opt pass then starts only from the seams and from cities
+// whose candidate lists cross a border.
+vector<int> partitionedTour(const vector<Point>& points, const Options& opts) {
+    int n = points.size();
+    if (n <= kRegionSize) return nnWith2Opt(points);
+
+    vector<int> cities(n);
+    for (int i = 0; i < n; i++) cities[i] = i;
+    vector<pair<int, int>> bounds;
+    bisectRegions(points, cities, 0, n, kRegionSize, bounds);
+    int r = bounds.size();
+
+    vector<Point> centroids;
+    centroids.reserve(r);
+    for (int i = 0; i < r; i++) {
+        double x = 0, y = 0;
+        for (int k = bounds[i].first; k < bounds[i].second; k++) {
+            x += points[cities[k]].x;
+            y += points[cities[k]].y;
         }
+        int size = bounds[i].second - bounds[i].first;
+        centroids.emplace_back(i, x / size, y / size);
     }
-    
-    sort(edges.begin(), edges.end());
-    
-    vector<pair<int, int>> matching;
-    vector<bool> matched(oddVertices.size(), false);
-    
-    for (const auto& edge : edges) {
-        int i = edge.second.first;
-        int j = edge.second.second;
-        
-        if (!matched[i] && !matched[j]) {
-            matching.push_back({oddVertices[i], oddVertices[j]});
-            matched[i] = true;
-            matched[j] = true;
+    vector<int> visit = hilbertOrder(centroids);
+
+    // regionPoints[i] holds region i in cycle order, trees[i] indexes it
+    vector<vector<int>> cycles(r);
+    vector<vector<Point>> regionPoints(r);
+    vector<unique_ptr<KdTree>> trees(r);
+    parallelFor(r, opts.threads, [&](int i) {
+        ScopedPhase phase("region");
+        const auto& b = bounds[visit[i]];
+        vector<Point> local;
+        local.reserve(b.second - b.first);
+        for (int k = b.first; k < b.second; k++) {
+            const Point& p = points[cities[k]];
+            local.emplace_back(k - b.first, p.x, p.y);
+        }
+        cycles[i] = nnWith2Opt(local);
+        for (int& c : cycles[i]) c = cities[b.first + c];
+        for (int c : cycles[i]) regionPoints[i].push_back(points[c]);
+        trees[i] = make_unique<KdTree>(regionPoints[i]);
+    });
+
+    // Positions in cycles[from] of the cities closest to region `to`
+    const size_t kBorderCities = 32;
+    auto border = [&](int from, int to) {
+        const auto& cycle = cycles[from];
+        vector<pair<double, int>> near(cycle.size());
+        for (int p = 0; p < (int)cycle.size(); p++) {
+            const Point& q = points[cycle[p]];
+            near[p] = {distance(q, regionPoints[to][trees[to]->nearest(q.x, q.y)]), p};
         }
+        size_t keep = min(near.size(), kBorderCities);
+        partial_sort(near.begin(), near.begin() + keep, near.end());
+        vector<int> result;
+        for (size_t t = 0; t < keep; t++) result.push_back(near[t].second);
+        return result;
+    };
+
+    // Region i is spliced into the tour built so far like a 2-opt move
+    // between two cycles: a tour edge (u, v) at a border city of region
+    // i - 1 and a cycle edge (x, y) at a border city of region i are
+    // replaced by u -> x ... y -> v or u -> y ... x -> v, whichever pair is
+    // cheapest. Both cross edges stay at the shared border.
+    vector<int> succ(n), pred(n);
+    auto link = [&](int a, int b) {
+        succ[a] = b;
+        pred[b] = a;
+    };
+    for (int k = 0; k < (int)cycles[0].size(); k++) {
+        link(cycles[0][k], cycles[0][(k + 1) % cycles[0].size()]);
     }
-    
-    return matching;
-}
+    auto dist = [&](int a, int b) { return distance(points[a], points[b]); };
 
-vector<int> buildTourFromEulerGraph(const vector<vector<int>>& eulerGraph, int n) {
-    vector<vector<int>> graphCopy = eulerGraph;
-    vector<int> euler;
-    eulerTourDFS(graphCopy, 0, euler);
-    reverse(euler.begin(), euler.end());
-    
-    vector<bool> visited(n, false);
-    vector<int> tour;
-    for (int v : euler) {
-        if (!visited[v]) {
-            visited[v] = true;
-            tour.push_back(v);
+    vector<int> seams;
+    for (int i = 1; i < r; i++) {
+        const auto& cycle = cycles[i];
+        int k = cycle.size();
+        vector<int> ours = border(i, i - 1);
+
+        double bestCost = numeric_limits<double>::infinity();
+        int bestU = -1, bestP = -1;
+        bool bestForward = true;
+        for (int pa : border(i - 1, i)) {
+            int a = cycles[i - 1][pa];
+            for (int u : {pred[a], a}) {
+                int v = succ[u];
+                double duv = dist(u, v);
+                for (int px : ours) {
+                    for (int p : {(px + k - 1) % k, px}) {
+                        int x = cycle[p], y = cycle[(p + 1) % k];
+                        double removed = duv + dist(x, y);
+                        double backward = dist(u, x) + dist(y, v) - removed;
+                        double forward = dist(u, y) + dist(x, v) - removed;
+                        if (min(forward, backward) < bestCost) {
+                            bestCost = min(forward, backward);
+                            bestU = u;
+                            bestP = p;
+                            bestForward = forward <= backward;
+                        }
+                    }
+                }
+            }
+        }
+
+        int u = bestU, v = succ[bestU], last = u;
+        for (int t = 0; t < k; t++) {
+            int c = bestForward ? cycle[(bestP + 1 + t) % k] : cycle[(bestP - t % k + k) % k];
+            link(last, c);
+            last = c;
         }
+        link(last, v);
+        seams.insert(seams.end(), {u, v, succ[u], last});
     }
-    
-    return tour;
-}
 
-vector<int> nearestNeighbor(const vector<Point>& points, int start = 0) {
-    int n = points.size();
-    vector<bool> visited(n, false);
     vector<int> tour;
     tour.reserve(n);
-    
-    int current = start;
-    tour.push_back(current);
-    visited[current] = true;
-    
-    for (int i = 1; i < n; i++) {
-        int nearest = -1;
-        double minDist = numeric_limits<double>::max();
-        
-        for (int j = 0; j < n; j++) {
-            if (!visited[j]) {
-                double d = distance(points[current], points[j]);
-                if (d < minDist) {
-                    minDist = d;
-                    nearest = j;
+    for (int c = cycles[0][0], t = 0; t < n; c = succ[c], t++) tour.push_back(c);
+    traceTour(points, tour);
+
+    vector<int> regionOf(n);
+    for (int i = 0; i < r; i++) {
+        for (int k = bounds[i].first; k < bounds[i].second; k++) regionOf[cities[k]] = i;
+    }
+    NeighborLists neighbors = buildNeighborLists(points, 10, opts.threads);
+
+    auto repair = [&](auto& t) {
+        LocalSearch<std::decay_t<decltype(t)>> search(points, t, neighbors);
+        search.setOrOpt(3);
+        search.pushAll(seams);
+        for (int c = 0; c < n; c++) {
+            for (const int* it = neighbors.begin(c); it != neighbors.end(c); ++it) {
+                if (regionOf[*it] != regionOf[c]) {
+                    search.push(c);
+                    break;
                 }
             }
         }
-        
-        current = nearest;
-        tour.push_back(current);
-        visited[current] = true;
+        search.run();
+        tour = t.cities();
+    };
+    if (n >= kTwoLevelMinSize) {
+        TwoLevelTour t(tour);
+        repair(t);
+    } else {
+        ArrayTour t(tour);
+        repair(t);
     }
-    
     return tour;
 }
 
+// ============================================================================
+// INCREMENTAL UPDATE
+// ============================================================================
 
+// Diff file lines: "+ id x y" adds a city, "- id" removes one
+struct PointDiff {
+    vector<Point> added;
+    vector<int> removed;
+};
 
-bool twoOptPass(const vector<Point>& points, vector<int>& tour) {
-    int n = tour.size();
-    bool improved = false;
-    
-    for (int i = 0; i < n - 1; i++) {
-        for (int j = i + 2; j < n; j++) {
-            if (j == n - 1 && i == 0) continue;
-            
-            int a = tour[i];
-            int b = tour[i + 1];
-            int c = tour[j];
-            int d = tour[(j + 1) % n];
-            
-            double delta = -distance(points[a], points[b]) 
-                         - distance(points[c], points[d])
-                         + distance(points[a], points[c]) 
-                         + distance(points[b], points[d]);
-            
-            if (delta < -1e-9) {
-                reverse(tour.begin() + i + 1, tour.begin() + j + 1);
-                improved = true;
-            }
+PointDiff readDiff(const string& filename) {
+    ifstream file(filename);
+    if (!file.is_open()) {
+        cerr << "Cannot open file: " << filename << endl;
+        exit(1);
+    }
+
+    PointDiff diff;
+    string line;
+    while (getline(file, line)) {
+        istringstream iss(line);
+        string op;
+        if (!(iss >> op)) continue;
+        int id;
+        double x, y;
+        if (op == "+" && iss >> id >> x >> y) {
+            diff.added.push_back(Point(id, x, y));
+        } else if (op == "-" && iss >> id) {
+            diff.removed.push_back(id);
+        } else {
+            cerr << "Bad diff line: " << line << endl;
+            exit(1);
         }
     }
-    
-    return improved;
+    return diff;
 }
 
-void twoOpt(const vector<Point>& points, vector<int>& tour, int maxIter = 1000) {
-    for (int iter = 0; iter < maxIter; iter++) {
-        if (!twoOptPass(points, tour)) break;
+vector<int> readTour(const string& filename) {
+    ifstream file(filename);
+    if (!file.is_open()) {
+        cerr << "Cannot open file: " << filename << endl;
+        exit(1);
     }
+
+    vector<int> ids;
+    int id;
+    while (file >> id) ids.push_back(id);
+    return ids;
 }
 
-vector<int> tsp2Approx(const vector<Point>& points) {
-    int n = points.size();
-    vector<vector<int>> mst = buildMST(points);
-    
-    vector<vector<int>> eulerGraph = mst;
-    for (int u = 0; u < n; u++) {
-        for (int v : mst[u]) {
-            eulerGraph[u].push_back(v);
-            eulerGraph[v].push_back(u);
+// Applies the diff to points and repairs the previous tour instead of
+// solving again: removed cities are cut out, added ones go in by cheapest
+// insertion next to one of their 10 nearest cities already on the tour
+// (k-d tree), and 2-opt + Or-opt runs only from the cities around the
+// changes. Candidate lists are computed lazily, so apart from reading the
+// input and building the k-d tree the work grows with the diff, not n.
+vector<int> incrementalTour(vector<Point>& points, const Options& opts) {
+    if (opts.prevTour.empty() || opts.diffFile.empty()) {
+        cerr << "incremental needs --prev-tour and --diff" << endl;
+        exit(1);
+    }
+    vector<int> prevIds = readTour(opts.prevTour);
+    PointDiff diff = readDiff(opts.diffFile);
+
+    unordered_map<int, int> indexOf;
+    for (int i = 0; i < (int)points.size(); i++) indexOf[points[i].id] = i;
+    if (prevIds.size() != points.size()) {
+        cerr << "Previous tour has " << prevIds.size() << " cities, input has " << points.size() << endl;
+        exit(1);
+    }
+
+    // The previous tour must be a permutation of the input ids
+    int m = prevIds.size();
+    vector<int> prevIndex(m);
+    vector<char> onTour(points.size(), 0);
+    for (int k = 0; k < m; k++) {
+        auto it = indexOf.find(prevIds[k]);
+        if (it == indexOf.end()) {
+            cerr << "Tour id not in input: " << prevIds[k] << endl;
+            exit(1);
+        }
+        if (onTour[it->second]) {
+            cerr << "Duplicate id in previous tour: " << prevIds[k] << endl;
+            exit(1);
         }
+        onTour[it->second] = 1;
+        prevIndex[k] = it->second;
     }
-    
-    return buildTourFromEulerGraph(eulerGraph, n);
-}
 
-vector<int> tsp15Approx(const vector<Point>& points) {
-    int n = points.size();
-    vector<vector<int>> mst = buildMST(points);
-    vector<int> oddVertices = getOddDegreeVertices(mst);
-    
-    vector<pair<int, int>> matching;
-    vector<bool> matched(oddVertices.size(), false);
-    
-    for (int i = 0; i < (int)oddVertices.size(); i++) {
-        if (matched[i]) continue;
-        
-        int bestJ = -1;
-        double bestDist = 1e18;
-        
-        for (int j = i + 1; j < (int)oddVertices.size(); j++) {
-            if (matched[j]) continue;
-            double dist = distance(points[oddVertices[i]], points[oddVertices[j]]);
-            if (dist < bestDist) {
-                bestDist = dist;
-                bestJ = j;
-            }
-        }
-        
-        if (bestJ != -1) {
-            matching.push_back({oddVertices[i], oddVertices[bestJ]});
-            matched[i] = true;
-            matched[bestJ] = true;
+    vector<char> removed(points.size(), 0);
+    for (int id : diff.removed) {
+        auto it = indexOf.find(id);
+        if (it == indexOf.end()) {
+            cerr << "Removed id not in input: " << id << endl;
+            exit(1);
         }
+        removed[it->second] = 1;
     }
-    
-    vector<vector<int>> eulerGraph = mst;
-    for (const auto& edge : matching) {
-        eulerGraph[edge.first].push_back(edge.second);
-        eulerGraph[edge.second].push_back(edge.first);
+
+    // Survivors keep input order; the previous tour is mapped onto them and
+    // cities that lost a tour neighbour become seeds for the local search
+    vector<Point> next;
+    next.reserve(points.size() - diff.removed.size() + diff.added.size());
+    vector<int> oldToNew(points.size(), -1);
+    for (int i = 0; i < (int)points.size(); i++) {
+        if (removed[i]) continue;
+        oldToNew[i] = next.size();
+        next.push_back(points[i]);
+    }
+    vector<int> tour, seeds;
+    for (int k = 0; k < m; k++) {
+        int city = oldToNew[prevIndex[k]];
+        if (city < 0) continue;
+        tour.push_back(city);
+        int before = prevIndex[(k + m - 1) % m], after = prevIndex[(k + 1) % m];
+        if (removed[before] || removed[after]) seeds.push_back(city);
     }
-    
-    return buildTourFromEulerGraph(eulerGraph, n);
-}
 
-vector<int> tsp15ApproxImproved(const vector<Point>& points) {
+    int base = next.size();
+    unordered_set<int> addedIds;
+    for (const auto& p : diff.added) {
+        auto it = indexOf.find(p.id);
+        if ((it != indexOf.end() && !removed[it->second]) || !addedIds.insert(p.id).second) {
+            cerr << "Added id already present: " << p.id << endl;
+            exit(1);
+        }
+        next.push_back(p);
+    }
+    points.swap(next);
     int n = points.size();
-    vector<vector<int>> mst = buildMST(points);
-    vector<int> oddVertices = getOddDegreeVertices(mst);
-    vector<pair<int, int>> matching = improvedMatching(points, oddVertices);
-    
-    vector<vector<int>> eulerGraph = mst;
-    for (const auto& edge : matching) {
-        eulerGraph[edge.first].push_back(edge.second);
-        eulerGraph[edge.second].push_back(edge.first);
+    metrics.points = n;
+    if (n == 0) return {};
+
+    // Cheapest insertion on a linked list; the k-d tree only holds cities
+    // that are already on the tour
+    vector<int> succ(n), pred(n);
+    for (int k = 0; k < (int)tour.size(); k++) {
+        succ[tour[k]] = tour[(k + 1) % tour.size()];
+        pred[tour[(k + 1) % tour.size()]] = tour[k];
     }
-    
-    return buildTourFromEulerGraph(eulerGraph, n);
-}
+    KdTree tree(points);
+    for (int c = base; c < n; c++) tree.remove(c);
 
-// Nearest Neighbor с 2-opt
-vector<int> nnWith2Opt(const vector<Point>& points) {
-    vector<int> tour = nearestNeighbor(points);
-    twoOpt(points, tour, 500);
+    auto dist = [&](int a, int b) { return distance(points[a], points[b]); };
+    for (int c = base; c < n; c++) {
+        if (tree.aliveCount() == 0) {
+            succ[c] = pred[c] = c;
+            tree.restore(c);
+            continue;
+        }
+        int bestA = -1;
+        double bestCost = numeric_limits<double>::max();
+        auto consider = [&](int q) {
+            for (int a : {pred[q], q}) {
+                double cost = dist(a, c) + dist(c, succ[a]) - dist(a, succ[a]);
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestA = a;
+                }
+            }
+        };
+        for (int q : tree.kNearest(c, 10)) {
+            if (tree.isAlive(q)) consider(q);
+        }
+        if (bestA < 0) consider(tree.nearest(points[c].x, points[c].y));
+
+        int b = succ[bestA];
+        succ[bestA] = c;
+        pred[c] = bestA;
+        succ[c] = b;
+        pred[b] = c;
+        tree.restore(c);
+        seeds.push_back(c);
+    }
+
+    tour.clear();
+    tour.reserve(n);
+    for (int c = 0, k = 0; k < n; c = succ[c], k++) tour.push_back(c);
+    traceTour(points, tour);
+    if (n < 8) return tour;
+
+    LazyNeighborLists neighbors(tree, n, 10);
+    auto repair = [&](auto& t) {
+        LocalSearch<std::decay_t<decltype(t)>, LazyNeighborLists> search(points, t, neighbors);
+        search.setOrOpt(3);
+        for (int c : seeds) {
+            search.push(c);
+            search.push(t.next(c));
+            search.push(t.prev(c));
+        }
+        search.run();
+        tour = t.cities();
+    };
+    if (n >= kTwoLevelMinSize) {
+        TwoLevelTour t(tour);
+        repair(t);
+    } else {
+        ArrayTour t(tour);
+        repair(t);
+    }
     return tour;
 }
 
@@ -337,27 +3784,120 @@ vector<int> nnWith2Opt(const vector<Point>& points) {
 // MAIN
 // ============================================================================
 
+// Upper limit for --threads and --starts: one thread is spawned per
+// worker, and multi-start keeps every start's tour in memory.
+const int kMaxCount = 1024;
+
 int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        cerr << "Usage: " << argv[0] << " <algorithm> [input_file] [output_file]" << endl;
+    Options opts;
+    vector<string> args;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.rfind("--", 0) != 0) {
+            args.push_back(arg);
+            continue;
+        }
+        if (arg == "--hilbert-order") {
+            opts.hilbertOrder = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            cerr << "Missing value for " << arg << endl;
+            return 1;
+        }
+        string value = argv[++i];
+        // Numeric values must parse completely; stoi & co. throw
+        // invalid_argument / out_of_range, both logic_errors
+        size_t parsed = value.size();
+        try {
+            if (arg == "--threads" || arg == "--starts") {
+                int count = stoi(value, &parsed);
+                if (count < 1 || count > kMaxCount) {
+                    cerr << arg << " expects a number from 1 to " << kMaxCount << endl;
+                    return 1;
+                }
+                (arg == "--threads" ? opts.threads : opts.starts) = count;
+            } else if (arg == "--seed") {
+                opts.seed = stoul(value, &parsed);
+            } else if (arg == "--time-limit") {
+                opts.timeLimit = stod(value, &parsed);
+            } else if (arg == "--prev-tour") {
+                opts.prevTour = value;
+            } else if (arg == "--diff") {
+                opts.diffFile = value;
+            } else if (arg == "--metrics") {
+                opts.metricsFile = value;
+            } else if (arg == "--gap") {
+                opts.gap = max(0.0, stod(value, &parsed));
+            } else {
+                cerr << "Unknown option: " << arg << endl;
+                return 1;
+            }
+        } catch (const logic_error&) {
+            parsed = 0;
+        }
+        if (parsed != value.size()) {
+            cerr << "Invalid value for " << arg << ": " << value << endl;
+            return 1;
+        }
+    }
+
+    if (args.empty()) {
+        cerr << "Usage: " << argv[0] << " <algorithm> [input_file] [output_file] [options]" << endl;
         cerr << "\nAlgorithms:" << endl;
         cerr << "  Basic:" << endl;
         cerr << "    2approx              - Double MST (2-approximation)" << endl;
-        cerr << "    15approx             - Christofides (1.5-approximation)" << endl;
-        cerr << "    15approx_improved    - Christofides with better matching" << endl;
+        cerr << "    15approx             - Christofides (1.5-approximation, blossom matching)" << endl;
+        cerr << "    15approx_improved    - Christofides with greedy candidate matching (faster)" << endl;
         cerr << "    nn                   - Nearest Neighbor" << endl;
+        cerr << "    hilbert              - Points in Hilbert curve order (fastest)" << endl;
         cerr << "\n  Optimized:" << endl;
         cerr << "    nn_2opt              - NN + 2-opt (RECOMMENDED - achieves < 1M)" << endl;
+        cerr << "    multi_nn_2opt        - Best of several NN + 2-opt starts, in parallel" << endl;
+        cerr << "    nn_2opt_3opt         - NN + 2-opt + Or-opt / segment insertion" << endl;
+        cerr << "    ils                  - Iterated local search with double-bridge kicks" << endl;
+        cerr << "\n  Advanced:" << endl;
+        cerr << "    christofides_full    - Christofides + Lin-Kernighan + Or-opt" << endl;
+        cerr << "    multi_nn_full        - Best of several NN + Lin-Kernighan starts, in parallel" << endl;
+        cerr << "    partition            - Regions solved in parallel with NN + 2-opt, then stitched" << endl;
+        cerr << "    incremental          - Update --prev-tour for the --diff of the input points" << endl;
+        cerr << "\n  Tools:" << endl;
+        cerr << "    convert              - Write the input points as a binary snapshot (output_file)" << endl;
+        cerr << "\nOptions:" << endl;
+        cerr << "  --threads N            - Worker threads (default: all cores)" << endl;
+        cerr << "  --starts N             - Start cities for multi_nn_* (default: 16)" << endl;
+        cerr << "  --seed N               - Random seed (default: 1)" << endl;
+        cerr << "  --time-limit SEC       - Wall-clock budget for ils (default: 10)" << endl;
+        cerr << "  --hilbert-order        - Reorder points along a Hilbert curve before solving" << endl;
+        cerr << "  --prev-tour FILE       - Previous output tour (incremental)" << endl;
+        cerr << "  --diff FILE            - Lines '+ id x y' / '- id' to apply to the input (incremental)" << endl;
+        cerr << "  --metrics FILE         - Write phase times, counters and a length trace as JSON" << endl;
+        cerr << "  --gap PCT              - Stop ils / multi-start once within PCT% of the Held-Karp bound" << endl;
         return 1;
     }
     
-    string algorithm = argv[1];
-    string input_file = (argc >= 3) ? argv[2] : "input.txt";
-    string output_file = (argc >= 4) ? argv[3] : "output.txt";
+    string algorithm = args[0];
+    string input_file = (args.size() >= 2) ? args[1] : "input.txt";
+    string output_file = (args.size() >= 3) ? args[2] : "output.txt";
+
+    if (algorithm == "convert") {
+        if (args.size() < 3) {
+            cerr << "Usage: " << argv[0] << " convert <input_file> <binary_file>" << endl;
+            return 1;
+        }
+        vector<Point> points = readPoints(input_file);
+        writeBinaryPoints(output_file, points);
+        cerr << "Converted " << points.size() << " points to " << output_file << endl;
+        return 0;
+    }
     
     auto start = high_resolution_clock::now();
+    metrics.enabled = !opts.metricsFile.empty();
+    metrics.start = steady_clock::now();
     
     vector<Point> points = readPoints(input_file);
+    if (opts.hilbertOrder) reorderAlongHilbert(points);
+    metrics.points = points.size();
     
     auto read_time = high_resolution_clock::now();
     auto read_duration = duration_cast<milliseconds>(read_time - start);
@@ -365,6 +3905,24 @@ int main(int argc, char* argv[]) {
     vector<int> tour;
     auto algo_start = high_resolution_clock::now();
     
+    // ils and multi-start stop at the gap, so they need the bound up front;
+    // incremental only reports it, for the points after the diff
+    bool stopsAtGap = algorithm == "ils" || algorithm == "multi_nn_2opt" || algorithm == "multi_nn_full";
+    if (opts.gap > 0 && !stopsAtGap && algorithm != "incremental") {
+        cerr << "--gap is only used by ils, multi_nn_2opt, multi_nn_full and incremental" << endl;
+        return 1;
+    }
+    auto computeLowerBound = [&]() {
+        if ((int)points.size() > kLowerBoundMaxSize) {
+            cerr << "--gap ignored: the lower bound is computed for up to " << kLowerBoundMaxSize << " cities" << endl;
+            opts.gap = 0;
+            return;
+        }
+        double upperBound = tourLength(points, hilbertOrder(points));
+        opts.lowerBound = heldKarpBound(points, buildNeighborLists(points, 10, opts.threads), upperBound);
+    };
+    if (opts.gap > 0 && stopsAtGap) computeLowerBound();
+
     // Выбор алгоритма
     if (algorithm == "2approx") {
         tour = tsp2Approx(points);
@@ -374,8 +3932,24 @@ int main(int argc, char* argv[]) {
         tour = tsp15ApproxImproved(points);
     } else if (algorithm == "nn") {
         tour = nearestNeighbor(points);
+    } else if (algorithm == "hilbert") {
+        tour = hilbertOrder(points);
     } else if (algorithm == "nn_2opt") {
         tour = nnWith2Opt(points);
+    } else if (algorithm == "multi_nn_2opt") {
+        tour = multiNNWith2Opt(points, opts);
+    } else if (algorithm == "nn_2opt_3opt") {
+        tour = nnWith2Opt3Opt(points);
+    } else if (algorithm == "ils") {
+        tour = iteratedLocalSearch(points, opts);
+    } else if (algorithm == "christofides_full") {
+        tour = christofidesFull(points);
+    } else if (algorithm == "multi_nn_full") {
+        tour = multiNNFull(points, opts);
+    } else if (algorithm == "partition") {
+        tour = partitionedTour(points, opts);
+    } else if (algorithm == "incremental") {
+        tour = incrementalTour(points, opts);
     } else {
         cerr << "Unknown algorithm: " << algorithm << endl;
         return 1;
@@ -383,6 +3957,7 @@ int main(int argc, char* argv[]) {
     
     auto algo_end = high_resolution_clock::now();
     auto algo_duration = duration_cast<milliseconds>(algo_end - algo_start);
+    if (opts.gap > 0 && !stopsAtGap) computeLowerBound();
     
     // Конвертируем индексы в ID и вычисляем длину
     vector<int> tourIds = tourIndicesToIds(points, tour);
@@ -399,10 +3974,20 @@ int main(int argc, char* argv[]) {
     cerr << "Algorithm: " << algorithm << endl;
     cerr << "Points: " << points.size() << endl;
     cerr << "Tour length: " << fixed << setprecision(2) << tour_len << endl;
+    if (opts.lowerBound > 0) {
+        cerr << "Lower bound: " << opts.lowerBound << " (gap "
+             << 100 * (tour_len / opts.lowerBound - 1) << "%)" << endl;
+    }
     cerr << "Read time: " << read_duration.count() << " ms" << endl;
     cerr << "Algorithm time: " << algo_duration.count() << " ms" << endl;
     cerr << "Write time: " << write_duration.count() << " ms" << endl;
     cerr << "Total time: " << total_duration.count() << " ms" << endl;
+
+    if (metrics.enabled) {
+        metrics.addLength(tour_len);
+        writeMetrics(opts.metricsFile, algorithm, points.size(), tour_len,
+                     {read_duration.count(), algo_duration.count(), write_duration.count(), total_duration.count()});
+    }
     
     return 0;
 }
\ No newline at end of file